@@ -114,6 +114,10 @@ install(
         FILES ${vinecop_hpp}
         DESTINATION "${include_install_dir}/vinecopulib/vinecop"
 )
+if (VINECOPULIB_SHARED_LIB)
+    # the quasi-random number tables are compiled into the library
+    list(FILTER misc_hpp EXCLUDE REGEX "tools_stats_(sobol|ghalton)\\.hpp$")
+endif()
 install(
         FILES ${misc_hpp}
         DESTINATION "${include_install_dir}/vinecopulib/misc"
@@ -24,7 +24,8 @@ if(NOT WIN32)
         set(CMAKE_CXX_FLAGS_RELEASE "-O3 -march=native -DNDEBUG")
     endif()
 
-    if(OPT_ASAN)
+    # the sanitizers replace malloc themselves
+    if(OPT_ASAN AND NOT VINECOPULIB_MEMORY_STATS)
         set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -fsanitize=address -fsanitize=undefined -fno-omit-frame-pointer")
         # set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -fsanitize=thread -fno-omit-frame-pointer")
     endif()
@@ -60,3 +61,7 @@ add_compile_definitions(
   BOOST_ALL_NO_LIB
   USE_BOOST
 )
+
+if(VINECOPULIB_MEMORY_STATS)
+  add_compile_definitions(VINECOPULIB_MEMORY_STATS)
+endif()
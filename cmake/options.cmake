@@ -13,3 +13,4 @@ option(BUILD_TESTING             "Build tests."                      ON)
 option(CODE_COVERAGE             "Code coverage."                    OFF)
 option(STRICT_COMPILER           "Stricter compiler warnings"        OFF)
 option(BUILD_DOC                 "Build documentation"               OFF)
+option(VINECOPULIB_MEMORY_STATS  "Count allocations in tests"        OFF)
@@ -21,4 +21,5 @@ message( STATUS "OPT_ASAN:                      ${OPT_ASAN}")
 message( STATUS "STRICT_COMPILER:               ${STRICT_COMPILER}")
 message( STATUS "CODE_COVERAGE:                 ${CODE_COVERAGE}")
 message( STATUS "BUILD_DOC:                     ${BUILD_DOC}")
+message( STATUS "VINECOPULIB_MEMORY_STATS:      ${VINECOPULIB_MEMORY_STATS}")
 message( STATUS )
\ No newline at end of file
@@ -1,58 +1,294 @@
+#pragma once
+
 #include <Eigen/Dense>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vinecopulib/misc/nlohmann_json.hpp>
+#include <vinecopulib/misc/tools_memory.hpp>
 
-// Computes the median of an Eigen::VectorXd
-double
-median(Eigen::VectorXd& v)
+// A benchmark in the style of Google Benchmark: `setup()` prepares the inputs
+// (untimed) and returns the function that is timed.
+struct Benchmark
+{
+  std::string name;
+  std::function<std::function<void()>()> setup;
+};
+
+// Command line options (same names as for Google Benchmark)
+struct BenchmarkOptions
+{
+  std::string filter = ".*";      // --benchmark_filter=<regex>
+  std::string out;                // --benchmark_out=<file> (JSON)
+  size_t repetitions = 3;         // --benchmark_repetitions=<n>
+  double min_time = 0.1;          // --benchmark_min_time=<seconds>
+  bool list_only = false;         // --benchmark_list_tests
+};
+
+// Time per iteration of one repetition
+struct Measurement
 {
-  // Sort the vector in-place
-  std::sort(v.data(), v.data() + v.size());
-  // Compute and return the median
-  return v.size() % 2 == 0 ? v.segment((v.size() - 2) / 2, 2).mean()
-                           : v(v.size() / 2);
+  size_t iterations;
+  double real_time; // microseconds
+  double cpu_time;  // microseconds (process time, i.e. summed over threads)
+};
+
+// Heap usage of a single iteration (only with VINECOPULIB_MEMORY_STATS)
+struct MemoryMeasurement
+{
+  size_t allocations;
+  size_t bytes;
+  size_t peak_bytes; // peak of live heap bytes during the iteration
+  size_t peak_rss;   // peak resident set size of the process
+};
+
+std::vector<Benchmark>&
+get_benchmarks()
+{
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
 }
 
-// Overload for const Eigen::VectorXd
-double
-median(const Eigen::VectorXd& v)
+void
+register_benchmark(const std::string& name,
+                   std::function<std::function<void()>()> setup)
 {
-  Eigen::VectorXd v_copy = v; // Make a copy of the vector
-  return median(v_copy);      // Delegate to the non-const version
+  get_benchmarks().push_back({ name, setup });
 }
 
-double
-std_dev(const Eigen::VectorXd& v)
+// Formats a number without trailing zeros (e.g., 0.5 instead of 0.500000)
+std::string
+format_number(double x)
 {
-  double mean = v.mean();
-  double sum = (v.array() - mean).square().sum();
-  return sqrt(sum / (v.size() - 1));
+  std::ostringstream out;
+  out << x;
+  return out.str();
 }
 
-// Benchmarking function with seed support using Eigen::VectorXi
-template<typename Function>
-Eigen::VectorXd
-benchmark_func(Function func, const Eigen::VectorXi& seeds)
+// Builds a name like "Vinecop/pdf/n:1000/d:5" from the parameters of a sweep
+std::string
+make_name(const std::string& prefix,
+          const std::vector<std::pair<std::string, std::string>>& args)
 {
-  unsigned repeats = seeds.size();
-  Eigen::VectorXd times = Eigen::VectorXd::Zero(repeats);
+  std::string name = prefix;
+  for (const auto& arg : args) {
+    name += "/" + arg.first + ":" + arg.second;
+  }
+  return name;
+}
 
-  for (unsigned i = 0; i < repeats; ++i) {
-    auto start = std::chrono::high_resolution_clock::now();
-    func(seeds(i)); // Pass the current seed to the function
-    auto end = std::chrono::high_resolution_clock::now();
-    times(i) = std::chrono::duration<double, std::milli>(end - start).count();
+BenchmarkOptions
+parse_options(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    auto value = arg.substr(arg.find('=') + 1);
+    if (arg.find("--benchmark_filter=") == 0) {
+      options.filter = value;
+    } else if (arg.find("--benchmark_out=") == 0) {
+      options.out = value;
+    } else if (arg.find("--benchmark_repetitions=") == 0) {
+      options.repetitions = std::max(std::stoi(value), 1);
+    } else if (arg.find("--benchmark_min_time=") == 0) {
+      options.min_time = std::stod(value);
+    } else if (arg == "--benchmark_list_tests") {
+      options.list_only = true;
+    } else {
+      throw std::runtime_error("unknown option: " + arg);
+    }
   }
+  return options;
+}
 
-  return times;
+// Runs `f` often enough that a repetition takes at least `min_time` seconds
+Measurement
+measure(const std::function<void()>& f, double min_time)
+{
+  size_t iterations = 1;
+  while (true) {
+    auto real_start = std::chrono::steady_clock::now();
+    std::clock_t cpu_start = std::clock();
+    for (size_t i = 0; i < iterations; ++i) {
+      f();
+    }
+    std::chrono::duration<double> real =
+      std::chrono::steady_clock::now() - real_start;
+    double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    if ((real.count() >= min_time) || (iterations >= 1000000000)) {
+      double iters = static_cast<double>(iterations);
+      return { iterations, 1e6 * real.count() / iters, 1e6 * cpu / iters };
+    }
+    // predict the number of iterations needed (at most 10 times more)
+    double multiplier = 1.4 * min_time / std::max(real.count(), 1e-9);
+    multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+    iterations =
+      static_cast<size_t>(static_cast<double>(iterations) * multiplier);
+  }
 }
 
-Eigen::VectorXd
-benchmark_stats(const Eigen::VectorXd& times)
+// Runs `f` once and counts its allocations
+MemoryMeasurement
+measure_memory(const std::function<void()>& f)
+{
+  using namespace vinecopulib::tools_memory;
+  reset_peak_rss();
+  reset_stats();
+  f();
+  auto stats = get_stats();
+  return { stats.allocations, stats.bytes, stats.peak_bytes, get_peak_rss() };
+}
+
+double
+median(std::vector<double> v)
 {
-  Eigen::VectorXd stats = Eigen::VectorXd::Zero(3);
-  stats(0) = times.mean();
-  stats(1) = median(times);
-  stats(2) = std_dev(times);
-  return stats;
-}
\ No newline at end of file
+  std::sort(v.begin(), v.end());
+  size_t n = v.size();
+  return (n % 2 == 0) ? (v[n / 2 - 1] + v[n / 2]) / 2 : v[n / 2];
+}
+
+double
+std_dev(const std::vector<double>& v)
+{
+  if (v.size() < 2) {
+    return 0.0;
+  }
+  double mean = 0.0, sum = 0.0;
+  for (auto x : v) {
+    mean += x / static_cast<double>(v.size());
+  }
+  for (auto x : v) {
+    sum += (x - mean) * (x - mean);
+  }
+  return std::sqrt(sum / static_cast<double>(v.size() - 1));
+}
+
+nlohmann::json
+make_context()
+{
+  auto now =
+    std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  char date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  nlohmann::json context;
+  context["date"] = date;
+  context["num_cpus"] = std::thread::hardware_concurrency();
+#ifdef NDEBUG
+  context["library_build_type"] = "release";
+#else
+  context["library_build_type"] = "debug";
+#endif
+  return context;
+}
+
+// Runs all benchmarks matching the filter, prints a table, and writes the
+// results in the JSON format of Google Benchmark if `options.out` is set.
+int
+run_benchmarks(const BenchmarkOptions& options)
+{
+  std::regex filter(options.filter);
+  nlohmann::json results = nlohmann::json::array();
+  bool count_memory = vinecopulib::tools_memory::is_counting();
+  std::cout << std::left << std::setw(88) << "Benchmark" << std::right
+            << std::setw(14) << "Time (us)" << std::setw(14) << "CPU (us)"
+            << std::setw(12) << "Iterations";
+  if (count_memory) {
+    std::cout << std::setw(12) << "Allocs" << std::setw(14) << "Bytes"
+              << std::setw(14) << "Peak heap" << std::setw(14) << "Peak RSS";
+  }
+  std::cout << std::endl;
+  std::cout << std::string(count_memory ? 182 : 128, '-') << std::endl;
+
+  for (const auto& benchmark : get_benchmarks()) {
+    if (!std::regex_search(benchmark.name, filter)) {
+      continue;
+    }
+    if (options.list_only) {
+      std::cout << benchmark.name << std::endl;
+      continue;
+    }
+
+    auto f = benchmark.setup();
+    f(); // warmup
+    MemoryMeasurement memory{ 0, 0, 0, 0 };
+    if (count_memory) {
+      memory = measure_memory(f);
+    }
+    std::vector<double> real_times, cpu_times;
+    for (size_t r = 0; r < options.repetitions; ++r) {
+      auto m = measure(f, options.min_time);
+      real_times.push_back(m.real_time);
+      cpu_times.push_back(m.cpu_time);
+      std::cout << std::left << std::setw(88) << benchmark.name << std::right
+                << std::fixed << std::setprecision(2) << std::setw(14)
+                << m.real_time << std::setw(14) << m.cpu_time << std::setw(12)
+                << m.iterations;
+      nlohmann::json result = { { "name", benchmark.name },
+                                { "run_name", benchmark.name },
+                                { "run_type", "iteration" },
+                                { "repetitions", options.repetitions },
+                                { "repetition_index", r },
+                                { "iterations", m.iterations },
+                                { "real_time", m.real_time },
+                                { "cpu_time", m.cpu_time },
+                                { "time_unit", "us" } };
+      if (count_memory) {
+        std::cout << std::setw(12) << memory.allocations << std::setw(14)
+                  << memory.bytes << std::setw(14) << memory.peak_bytes
+                  << std::setw(14) << memory.peak_rss;
+        // user counters, as reported by Google Benchmark
+        result["allocations"] = memory.allocations;
+        result["allocated_bytes"] = memory.bytes;
+        result["peak_heap_bytes"] = memory.peak_bytes;
+        result["peak_rss_bytes"] = memory.peak_rss;
+      }
+      std::cout << std::endl;
+      results.push_back(result);
+    }
+
+    if (options.repetitions > 1) {
+      std::vector<std::pair<std::string, std::function<double(
+                                           const std::vector<double>&)>>>
+        aggregates = { { "mean",
+                         [](const std::vector<double>& v) {
+                           double s = 0.0;
+                           for (auto x : v) {
+                             s += x;
+                           }
+                           return s / static_cast<double>(v.size());
+                         } },
+                       { "median", median },
+                       { "stddev", std_dev } };
+      for (const auto& aggregate : aggregates) {
+        results.push_back(
+          { { "name", benchmark.name + "_" + aggregate.first },
+            { "run_name", benchmark.name },
+            { "run_type", "aggregate" },
+            { "repetitions", options.repetitions },
+            { "aggregate_name", aggregate.first },
+            { "real_time", aggregate.second(real_times) },
+            { "cpu_time", aggregate.second(cpu_times) },
+            { "time_unit", "us" } });
+      }
+    }
+  }
+
+  if (!options.out.empty()) {
+    nlohmann::json output;
+    output["context"] = make_context();
+    output["benchmarks"] = results;
+    std::ofstream file(options.out);
+    file << output.dump(2) << std::endl;
+  }
+  return 0;
+}
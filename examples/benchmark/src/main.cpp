@@ -1,19 +1,25 @@
-#include "benchmark.hpp"
 #include <iostream>
 #include <map>
+#include <memory>
 #include <random>
 #include <string>
+#include <thread>
 #include <vinecopulib.hpp>
+#include <vinecopulib/misc/tools_interpolation.hpp>
+#include <vinecopulib/misc/tools_stl.hpp>
+#include <vinecopulib/misc/tools_thread.hpp>
 
 #include "benchmark.hpp"
 
 using namespace std;
 using namespace vinecopulib;
 using Eigen::MatrixXd;
+using Eigen::VectorXd;
 
-// Utility function to generate random data using Eigen
+// Utility function to generate random data using Eigen; a negative
+// `dependence` gives negatively dependent data
 Eigen::MatrixXd
-generate_data(int n, int d, unsigned seed)
+generate_data(int n, int d, unsigned seed, double dependence = 1.0)
 {
 
   std::mt19937 gen(seed);
@@ -23,115 +29,324 @@ generate_data(int n, int d, unsigned seed)
   for (int i = 0; i < n; ++i) {
     double x = dist(gen);
     for (int j = 0; j < d; ++j) {
-      data(i, j) = x * 1.0 + 0.5 * dist(gen);
+      data(i, j) = x * ((j % 2) ? dependence : 1.0) + 0.5 * dist(gen);
     }
   }
   return tools_stats::to_pseudo_obs(data);
 }
 
+// A pair-copula of the given family and rotation fitted to moderately
+// dependent data
+Bicop
+make_bicop(BicopFamily family, int rotation)
+{
+  bool negative = (rotation == 90) || (rotation == 270);
+  auto u = generate_data(1000, 2, 1, negative ? -1.0 : 1.0);
+  Bicop bc(family, rotation);
+  bc.fit(u);
+  return bc;
+}
+
+// A vine on a random structure with the same pair-copula on all edges
+Vinecop
+make_vinecop(BicopFamily family, size_t d, size_t trunc_lvl)
+{
+  auto structure = RVineStructure::simulate(d, false, { 1 });
+  auto pcs = Vinecop::make_pair_copula_store(d);
+  auto bc = make_bicop(family, 0);
+  for (auto& tree : pcs) {
+    for (auto& pc : tree) {
+      pc = bc;
+    }
+  }
+  Vinecop vc(structure, pcs);
+  vc.truncate(trunc_lvl);
+  return vc;
+}
+
 void
-benchmark_vinecop_fitting(int n = 1000, int d = 5, unsigned int repeats = 10)
+register_bicop_benchmarks()
 {
+  std::vector<BicopFamily> families = {
+    BicopFamily::gaussian, BicopFamily::student, BicopFamily::clayton,
+    BicopFamily::gumbel,   BicopFamily::frank,   BicopFamily::joe,
+    BicopFamily::bb1,      BicopFamily::bb7,     BicopFamily::tll
+  };
+  std::vector<std::string> methods = { "pdf",    "cdf",   "hfunc1",
+                                       "hfunc2", "hinv1", "hinv2" };
+
+  for (auto family : families) {
+    std::vector<int> rotations = { 0 };
+    if (!tools_stl::is_member(family, bicop_families::rotationless)) {
+      rotations.push_back(90);
+    }
+    for (int rotation : rotations) {
+      for (int n : { 1000, 100000 }) {
+        for (const auto& method : methods) {
+          auto name = make_name("Bicop/" + method,
+                                { { "family", get_family_name(family) },
+                                  { "rotation", to_string(rotation) },
+                                  { "n", to_string(n) } });
+          register_benchmark(name, [=] {
+            auto bc = std::make_shared<Bicop>(make_bicop(family, rotation));
+            bool negative = (rotation == 90);
+            auto u = std::make_shared<MatrixXd>(
+              generate_data(n, 2, 2, negative ? -1.0 : 1.0));
+            std::function<VectorXd(const MatrixXd&)> f;
+            if (method == "pdf") {
+              f = [bc](const MatrixXd& x) { return bc->pdf(x); };
+            } else if (method == "cdf") {
+              f = [bc](const MatrixXd& x) { return bc->cdf(x); };
+            } else if (method == "hfunc1") {
+              f = [bc](const MatrixXd& x) { return bc->hfunc1(x); };
+            } else if (method == "hfunc2") {
+              f = [bc](const MatrixXd& x) { return bc->hfunc2(x); };
+            } else if (method == "hinv1") {
+              f = [bc](const MatrixXd& x) { return bc->hinv1(x); };
+            } else {
+              f = [bc](const MatrixXd& x) { return bc->hinv2(x); };
+            }
+            return std::function<void()>([=] { f(*u); });
+          });
+        }
+      }
+    }
+  }
+
+  for (auto family : families) {
+    for (int n : { 1000, 10000 }) {
+      auto name = make_name(
+        "Bicop/fit",
+        { { "family", get_family_name(family) }, { "n", to_string(n) } });
+      register_benchmark(name, [=] {
+        auto u = std::make_shared<MatrixXd>(generate_data(n, 2, 3));
+        return std::function<void()>([=] {
+          Bicop bc(family);
+          bc.fit(*u);
+        });
+      });
+    }
+  }
+
+  for (std::string family_set : { "itau", "all" }) {
+    for (int n : { 1000, 10000 }) {
+      for (size_t threads : { 1, 4 }) {
+        auto name = make_name("Bicop/select",
+                              { { "families", family_set },
+                                { "n", to_string(n) },
+                                { "threads", to_string(threads) } });
+        register_benchmark(name, [=] {
+          auto u = std::make_shared<MatrixXd>(generate_data(n, 2, 4));
+          FitControlsBicop controls(family_set == "itau" ? bicop_families::itau
+                                                         : bicop_families::all);
+          controls.set_num_threads(threads);
+          return std::function<void()>([=] {
+            Bicop bc;
+            bc.select(*u, controls);
+          });
+        });
+      }
+    }
+  }
+}
 
-  // Seeds for benchmarking
-  Eigen::VectorXi seeds = Eigen::VectorXi::LinSpaced(repeats, 1, repeats);
+void
+register_vinecop_benchmarks()
+{
+  std::vector<BicopFamily> families = { BicopFamily::gaussian,
+                                        BicopFamily::gumbel,
+                                        BicopFamily::tll };
+  std::vector<std::string> methods = { "pdf",        "loglik",
+                                       "rosenblatt", "inverse_rosenblatt",
+                                       "simulate",   "cdf" };
+  size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
 
-  // Benchmark data generation
-  Eigen::VectorXd times_generate_data = benchmark_func(
-    [&](unsigned seed) { auto u = generate_data(n, d, seed); }, seeds);
+  for (const auto& method : methods) {
+    for (auto family : families) {
+      for (size_t d : { 5, 20 }) {
+        for (size_t trunc_lvl : { static_cast<size_t>(3), d - 1 }) {
+          // cdf() simulates 10^4 samples for each evaluation point
+          std::vector<int> sizes = { 1000, 100000 };
+          if (method == "cdf") {
+            sizes = { 10, 100 };
+          }
+          for (int n : sizes) {
+            for (size_t threads : { static_cast<size_t>(1), max_threads }) {
+              // pinning only matters for evaluations with several threads
+              std::vector<bool> pinnings = { false };
+              if ((threads > 1) && (method != "cdf")) {
+                pinnings.push_back(true);
+              }
+              for (bool pinned : pinnings) {
+                auto name = make_name("Vinecop/" + method,
+                                      { { "family", get_family_name(family) },
+                                        { "d", to_string(d) },
+                                        { "trunc", to_string(trunc_lvl) },
+                                        { "n", to_string(n) },
+                                        { "threads", to_string(threads) },
+                                        { "pinned", to_string(pinned) } });
+                register_benchmark(name, [=] {
+                  tools_thread::set_executor(
+                    pinned
+                      ? std::make_shared<tools_thread::Executor>(threads, true)
+                      : nullptr);
+                  auto vc = std::make_shared<Vinecop>(
+                    make_vinecop(family, d, trunc_lvl));
+                  auto u = std::make_shared<MatrixXd>(
+                    vc->simulate(n, false, 1, { 5 }));
+                  std::function<void()> f;
+                  if (method == "pdf") {
+                    f = [=] { vc->pdf(*u, threads); };
+                  } else if (method == "loglik") {
+                    f = [=] { vc->loglik(*u, threads); };
+                  } else if (method == "rosenblatt") {
+                    f = [=] { vc->rosenblatt(*u, threads); };
+                  } else if (method == "inverse_rosenblatt") {
+                    f = [=] { vc->inverse_rosenblatt(*u, threads); };
+                  } else if (method == "simulate") {
+                    f = [=] { vc->simulate(n, false, threads); };
+                  } else {
+                    f = [=] { vc->cdf(*u, 1e4, threads); };
+                  }
+                  return f;
+                });
+              }
+            }
+          }
+        }
+      }
+    }
+  }
 
-  // Define different FitControls configurations
   std::map<std::string, FitControlsVinecop> controls_configs = {
     { "itau", FitControlsVinecop(bicop_families::itau) },
     { "itau_par_method", FitControlsVinecop(bicop_families::itau, "itau") },
     { "tll", FitControlsVinecop({ BicopFamily::tll }) }
   };
+  for (const auto& config : controls_configs) {
+    for (size_t d : { 5, 10 }) {
+      for (int n : { 1000, 10000 }) {
+        for (size_t trunc_lvl : { static_cast<size_t>(2), d - 1 }) {
+          for (size_t threads : { static_cast<size_t>(1), max_threads }) {
+            auto name = make_name("Vinecop/select",
+                                  { { "controls", config.first },
+                                    { "d", to_string(d) },
+                                    { "trunc", to_string(trunc_lvl) },
+                                    { "n", to_string(n) },
+                                    { "threads", to_string(threads) } });
+            auto controls = config.second;
+            register_benchmark(name, [=]() mutable {
+              tools_thread::set_executor(nullptr);
+              auto u = std::make_shared<MatrixXd>(generate_data(n, d, 6));
+              controls.set_trunc_lvl(trunc_lvl);
+              controls.set_num_threads(threads);
+              return std::function<void()>([=] {
+                Vinecop vc(d);
+                vc.select(*u, controls);
+              });
+            });
+          }
+        }
+      }
+    }
+  }
+}
 
-  // Wrapper function to generate data and fit a Vinecop
-  auto generate_and_fit = [&](unsigned seed,
-                              const FitControlsVinecop& controls) {
-    auto u = generate_data(n, d, seed);
-    Vinecop vc(u, RVineStructure(), {}, controls);
-  };
+void
+register_stats_benchmarks()
+{
+  for (int n : { 1000, 100000 }) {
+    for (int d : { 2, 10, 100 }) {
+      auto args = vector<pair<string, string>>{ { "n", to_string(n) },
+                                                { "d", to_string(d) } };
+      register_benchmark(make_name("tools_stats/sobol", args), [=] {
+        return std::function<void()>(
+          [=] { tools_stats::sobol(n, d, { 1 }); });
+      });
+      register_benchmark(make_name("tools_stats/ghalton", args), [=] {
+        return std::function<void()>(
+          [=] { tools_stats::ghalton(n, d, { 1 }); });
+      });
+      register_benchmark(make_name("tools_stats/simulate_uniform", args), [=] {
+        return std::function<void()>(
+          [=] { tools_stats::simulate_uniform(n, d, false, { 1 }); });
+      });
+    }
 
-  // Benchmark different configurations
-  cout << "Benchmark Results for Vinecop Fitting (ms):" << endl;
-  for (const auto& config : controls_configs) {
-    Eigen::VectorXd time_fit = benchmark_func(
-      [&](unsigned seed) { generate_and_fit(seed, config.second); }, seeds);
-    cout << config.first << ": "
-         << benchmark_stats(time_fit - times_generate_data).transpose() << endl;
+    for (double rho : { 0.0, 0.5, 0.95 }) {
+      auto args = vector<pair<string, string>>{ { "n", to_string(n) },
+                                                { "rho", format_number(rho) } };
+      register_benchmark(make_name("tools_stats/pbvnorm", args), [=] {
+        auto z = std::make_shared<MatrixXd>(
+          tools_stats::qnorm(generate_data(n, 2, 7)));
+        return std::function<void()>(
+          [=] { tools_stats::pbvnorm(*z, rho); });
+      });
+      for (int nu : { 3, 10 }) {
+        args.push_back({ "nu", to_string(nu) });
+        register_benchmark(make_name("tools_stats/pbvt", args), [=] {
+          auto z = std::make_shared<MatrixXd>(
+            tools_stats::qt(generate_data(n, 2, 7), nu));
+          return std::function<void()>(
+            [=] { tools_stats::pbvt(*z, nu, rho); });
+        });
+        args.pop_back();
+      }
+    }
   }
 }
 
 void
-benchmark_bicop_tll(int n = 1000, unsigned int repeats = 10)
+register_interpolation_benchmarks()
 {
-  FitControlsBicop controls_tll({ BicopFamily::tll }); // Define FitControls
-
-  // Seeds for benchmarking
-  Eigen::VectorXi seeds = Eigen::VectorXi::LinSpaced(repeats, 1, repeats);
-
-  // Warmup
-  auto warmup = benchmark_func(
-    [&](unsigned seed) {
-      auto u = generate_data(n, 2, seed);
-      Bicop bc(u, controls_tll);
-    },
-    seeds);
-
-
-  // Benchmark data generation
-  Eigen::VectorXd times_generate_data = benchmark_func(
-    [&](unsigned seed) { auto u = generate_data(n, 2, seed); }, seeds);
-
-  // Benchmark fitting
-  Eigen::VectorXd time_fit_tll = benchmark_func(
-    [&](unsigned seed) {
-      auto u = generate_data(n, 2, seed);
-      Bicop bc(u, controls_tll);
-    },
-    seeds);
-
-  cout << "Benchmark Results for Bicop tll (ms):" << endl;
-  cout << "fit: "
-       << benchmark_stats(time_fit_tll - times_generate_data).transpose()
-       << endl;
-
-  // Benchmark different methods
-  std::vector<std::string> methods = { "pdf",    "cdf",   "hfunc1",
-                                       "hfunc2", "hinv1", "hinv2" };
+  std::vector<std::string> methods = { "interpolate",
+                                       "integrate_1d",
+                                       "integrate_2d" };
   for (const auto& method : methods) {
-    Eigen::VectorXd time_method = benchmark_func(
-      [&](unsigned seed) {
-        auto u = generate_data(n, 2, seed);
-        Bicop bc(u, controls_tll);
-        if (method == "pdf") {
-          auto d = bc.pdf(u);
-        } else if (method == "cdf") {
-          auto p = bc.cdf(u);
-        } else if (method == "hfunc1") {
-          auto h1 = bc.hfunc1(u);
-        } else if (method == "hfunc2") {
-          auto h2 = bc.hfunc2(u);
-        } else if (method == "hinv1") {
-          auto u1 = bc.hinv1(u);
-        } else if (method == "hinv2") {
-          auto u2 = bc.hinv2(u);
-        }
-      },
-      seeds);
-    cout << method << ": "
-         << benchmark_stats(time_method - time_fit_tll).transpose() << endl;
+    for (int m : { 30, 50 }) {
+      for (int n : { 1000, 100000 }) {
+        auto name = make_name("InterpolationGrid/" + method,
+                              { { "grid", to_string(m) },
+                                { "n", to_string(n) } });
+        register_benchmark(name, [=] {
+          // density of a Gaussian copula on the grid
+          Bicop bc(BicopFamily::gaussian, 0, VectorXd::Constant(1, 0.5));
+          VectorXd grid_points = VectorXd::LinSpaced(m, 0.0001, 0.9999);
+          MatrixXd grid(m * m, 2);
+          for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < m; ++j) {
+              grid.row(i * m + j) << grid_points(i), grid_points(j);
+            }
+          }
+          VectorXd density = bc.pdf(grid);
+          MatrixXd values =
+            Eigen::Map<MatrixXd>(density.data(), m, m).transpose();
+          using tools_interpolation::InterpolationGrid;
+          auto interp =
+            std::make_shared<InterpolationGrid>(grid_points, values);
+          auto u = std::make_shared<MatrixXd>(generate_data(n, 2, 8));
+          std::function<void()> f;
+          if (method == "interpolate") {
+            f = [=] { interp->interpolate(*u); };
+          } else if (method == "integrate_1d") {
+            f = [=] { interp->integrate_1d(*u, 1); };
+          } else {
+            f = [=] { interp->integrate_2d(*u); };
+          }
+          return f;
+        });
+      }
+    }
   }
 }
 
 int
-main()
+main(int argc, char** argv)
 {
+  register_bicop_benchmarks();
+  register_vinecop_benchmarks();
+  register_stats_benchmarks();
+  register_interpolation_benchmarks();
 
-  benchmark_vinecop_fitting();
-  benchmark_bicop_tll();
-
-  return 0;
+  return run_benchmarks(parse_options(argc, argv));
 }
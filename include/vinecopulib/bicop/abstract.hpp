@@ -54,7 +54,10 @@ protected:
   virtual void fit(const Eigen::MatrixXd& data,
                    std::string method,
                    double mult,
-                   const Eigen::VectorXd& weights) = 0;
+                   const Eigen::VectorXd& weights,
+                   bool warm_start,
+                   double tau,
+                   size_t maxeval) = 0;
 
   virtual double get_npars() const = 0;
 
@@ -105,6 +108,7 @@ protected:
   // Data members
   BicopFamily family_;
   double loglik_{ NAN };
+  size_t objective_calls_{ 0 }; // in the last fit
   std::vector<std::string> var_types_{ "c", "c" };
 };
 
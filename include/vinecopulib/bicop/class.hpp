@@ -7,7 +7,7 @@
 #pragma once
 
 #include <vinecopulib/bicop/fit_controls.hpp>
-#include <vinecopulib/misc/nlohmann_json.hpp>
+#include <vinecopulib/misc/nlohmann_json_fwd.hpp>
 
 namespace vinecopulib {
 
@@ -15,6 +15,10 @@ namespace vinecopulib {
 class AbstractBicop;
 using BicopPtr = std::shared_ptr<AbstractBicop>;
 
+namespace tools_select {
+class BicopSelector;
+}
+
 //! @brief A class for bivariate copula models.
 //!
 //! @details The model is fully characterized by the family, 
@@ -44,6 +48,7 @@ using BicopPtr = std::shared_ptr<AbstractBicop>;
 //!
 class Bicop
 {
+  friend class tools_select::BicopSelector;
 
 public:
   // Constructors
@@ -87,6 +92,8 @@ public:
   double get_aic() const;
   double get_bic() const;
   double get_mbic(const double psi0 = 0.9) const;
+  size_t get_num_skipped_fits() const;
+  size_t get_num_objective_calls() const;
 
   void set_rotation(const int rotation);
 
@@ -147,6 +154,11 @@ public:
   Bicop as_continuous() const;
 
 private:
+  void fit(const Eigen::MatrixXd& data,
+           const FitControlsBicop& controls,
+           double tau,
+           size_t maxeval = 0);
+
   Eigen::MatrixXd format_data(const Eigen::MatrixXd& u) const;
 
   void rotate_data(Eigen::MatrixXd& u) const;
@@ -177,6 +189,8 @@ private:
   BicopPtr bicop_;
   int rotation_{ 0 };
   size_t nobs_{ 0 };
+  size_t num_skipped_fits_{ 0 };
+  size_t num_objective_calls_{ 0 };
   mutable std::vector<std::string> var_types_;
 };
 }
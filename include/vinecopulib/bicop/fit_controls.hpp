@@ -7,6 +7,7 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <limits>
 #include <vector>
 #include <vinecopulib/bicop/family.hpp>
 #include <vinecopulib/misc/fit_controls.hpp>
@@ -57,6 +58,16 @@ public:
 
   bool get_allow_rotations() const;
 
+  bool get_warm_start() const;
+
+  bool get_warm_start_neighbors() const;
+
+  double get_pruning_margin() const;
+
+  std::shared_ptr<CancellationToken> get_cancellation_token() const;
+
+  std::shared_ptr<Observer> get_observer() const;
+
   // Setters
   void set_family_set(std::vector<BicopFamily> family_set);
 
@@ -78,6 +89,16 @@ public:
 
   void set_allow_rotations(bool allow_rotations);
 
+  void set_warm_start(bool warm_start);
+
+  void set_warm_start_neighbors(bool warm_start_neighbors);
+
+  void set_pruning_margin(double pruning_margin);
+
+  void set_cancellation_token(std::shared_ptr<CancellationToken> token);
+
+  void set_observer(std::shared_ptr<Observer> observer);
+
   // Misc
   std::string str() const;
 
@@ -95,6 +116,11 @@ private:
   double psi0_;
   size_t num_threads_;
   bool allow_rotations_;
+  bool warm_start_{ false };
+  bool warm_start_neighbors_{ false };
+  double pruning_margin_{ std::numeric_limits<double>::infinity() };
+  std::shared_ptr<CancellationToken> cancellation_token_;
+  std::shared_ptr<Observer> observer_;
 
   void check_parametric_method(std::string parametric_method);
 
@@ -106,6 +132,8 @@ private:
 
   void check_psi0(double psi0);
 
+  void check_pruning_margin(double pruning_margin);
+
   size_t process_num_threads(size_t num_threads);
 };
 }
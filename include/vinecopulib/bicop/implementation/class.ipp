@@ -7,6 +7,7 @@
 #include <mutex>
 #include <vinecopulib/bicop/abstract.hpp>
 #include <vinecopulib/bicop/tools_select.hpp>
+#include <vinecopulib/misc/tools_eigen.hpp>
 #include <vinecopulib/misc/tools_interface.hpp>
 #include <vinecopulib/misc/tools_serialization.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
@@ -51,8 +52,8 @@ inline Bicop::Bicop(const BicopFamily family,
 inline Bicop::Bicop(const Eigen::MatrixXd& data,
                     const FitControlsBicop& controls,
                     const std::vector<std::string>& var_types)
+  : Bicop(BicopFamily::indep, 0, Eigen::MatrixXd(), var_types)
 {
-  set_var_types(var_types);
   select(data, controls);
 }
 
@@ -66,6 +67,8 @@ inline Bicop::Bicop(const Bicop& other)
           other.get_var_types())
 {
   nobs_ = other.nobs_;
+  num_skipped_fits_ = other.num_skipped_fits_;
+  num_objective_calls_ = other.num_objective_calls_;
   bicop_->set_loglik(other.bicop_->get_loglik());
   bicop_->set_npars(other.bicop_->get_npars());
 }
@@ -80,6 +83,8 @@ Bicop::operator=(Bicop other)
   std::swap(bicop_, other.bicop_);
   std::swap(rotation_, other.rotation_);
   std::swap(nobs_, other.nobs_);
+  std::swap(num_skipped_fits_, other.num_skipped_fits_);
+  std::swap(num_objective_calls_, other.num_objective_calls_);
   std::swap(var_types_, other.var_types_);
   return *this;
 }
@@ -602,6 +607,23 @@ Bicop::get_nobs() const
   return nobs_;
 }
 
+//! @brief Gets the number of candidates for which the full fit was skipped
+//! in the last call to `select()` (see
+//! `FitControlsBicop::set_pruning_margin()`).
+inline size_t
+Bicop::get_num_skipped_fits() const
+{
+  return num_skipped_fits_;
+}
+
+//! @brief Gets the number of objective function evaluations in the last call
+//! to `fit()` or, summed over all candidates, `select()`.
+inline size_t
+Bicop::get_num_objective_calls() const
+{
+  return num_objective_calls_;
+}
+
 //! @brief Gets the aic (only for fitted objects).
 inline double
 Bicop::get_aic() const
@@ -832,11 +854,31 @@ Bicop::as_continuous() const
 //!
 //! Incomplete observations (i.e., ones with a NaN value) are discarded.
 //!
+//! If `controls.get_observer()` is set, the fit is reported to
+//! `Observer::on_fit()`.
+//!
 //! @param data An \f$ n \times (2 + k) \f$ matrix of observations contained in
 //!   \f$(0, 1) \f$, where \f$ k \f$ is the number of discrete variables.
 //! @param controls The controls (see `FitControlsBicop`).
 inline void
 Bicop::fit(const Eigen::MatrixXd& data, const FitControlsBicop& controls)
+{
+  fit(data, controls, std::numeric_limits<double>::quiet_NaN());
+}
+
+//! @brief Fits the model for a known Kendall's \f$ \tau \f$ of the data
+//! (if not NaN), which spares its computation in parametric fits.
+//! @param data See `fit()`.
+//! @param controls See `fit()`.
+//! @param tau The (weighted) Kendall's \f$ \tau \f$ of the complete
+//!   observations in `data`.
+//! @param maxeval The maximal number of evaluations of the objective in
+//!   parametric fits (0 for the default of the optimizer).
+inline void
+Bicop::fit(const Eigen::MatrixXd& data,
+           const FitControlsBicop& controls,
+           double tau,
+           size_t maxeval)
 {
   std::string method;
   if (tools_stl::is_member(bicop_->get_family(), bicop_families::parametric)) {
@@ -851,11 +893,29 @@ Bicop::fit(const Eigen::MatrixXd& data, const FitControlsBicop& controls)
   check_weights_size(w, data);
   tools_eigen::remove_nans(data_no_nan, w);
 
+  auto observer = controls.get_observer();
+  ObserverTimer timer(observer.get());
+  if ((rotation_ == 90) || (rotation_ == 270)) {
+    tau = -tau; // rotated data have the opposite association
+  }
   bicop_->fit(prep_for_abstract(data_no_nan),
               method,
               controls.get_nonparametric_mult(),
-              w);
+              w,
+              controls.get_warm_start(),
+              tau,
+              maxeval);
   nobs_ = data_no_nan.rows();
+  num_objective_calls_ = bicop_->objective_calls_;
+  if (observer) {
+    observer->on_fit({ get_family(),
+                       rotation_,
+                       method,
+                       nobs_,
+                       bicop_->get_loglik(),
+                       num_objective_calls_,
+                       timer.get_seconds() });
+  }
 }
 
 //
@@ -877,6 +937,18 @@ Bicop::fit(const Eigen::MatrixXd& data, const FitControlsBicop& controls)
 //!
 //! Incomplete observations (i.e., ones with a NaN value) are discarded.
 //!
+//! If `controls.get_warm_start()` is true, the candidate with the current
+//! family and rotation is fitted starting from the current parameters. If
+//! additionally `controls.get_warm_start_neighbors()` is true, only the
+//! current family and its neighbors (see
+//! `tools_select::get_neighbor_families()`) are considered.
+//!
+//! If `controls.get_pruning_margin()` is finite and the parametric method is
+//! `"mle"`, candidates are first scored by a cheap `"itau"` fit and only those
+//! within the margin of the best score are fitted by `"mle"` (see
+//! `FitControlsBicop::set_pruning_margin()`). The number of skipped fits can
+//! be retrieved with `get_num_skipped_fits()`.
+//!
 //! @param data An \f$ n \times (2 + k) \f$ matrix of observations contained in
 //!   \f$(0, 1) \f$, where \f$ k \f$ is the number of discrete variables.
 //! @param controls The controls (see `FitControlsBicop`).
@@ -884,6 +956,7 @@ inline void
 Bicop::select(const Eigen::MatrixXd& data, FitControlsBicop controls)
 {
   using namespace tools_select;
+  CancellationScope cancellation_scope(controls.get_cancellation_token());
   check_weights_size(controls.get_weights(), data);
   Eigen::MatrixXd data_no_nan = data;
   {
@@ -892,72 +965,25 @@ Bicop::select(const Eigen::MatrixXd& data, FitControlsBicop controls)
     controls.set_weights(w);
   }
   check_data(data_no_nan);
-  nobs_ = data_no_nan.rows();
-
-  bicop_ = AbstractBicop::create();
-  bicop_->set_var_types(var_types_);
-  rotation_ = 0;
-  bicop_->set_loglik(0.0);
-  if (data_no_nan.rows() >= 10) {
-    tools_eigen::trim(data_no_nan);
-    std::vector<Bicop> bicops = create_candidate_bicops(data_no_nan, controls);
-    for (auto& bc : bicops) {
-      bc.set_var_types(var_types_);
-    }
-
-    // Estimate all models and select the best one using the
-    // selection_criterion
-    double fitted_criterion = std::numeric_limits<double>::max();
-    std::mutex m;
-    auto fit_and_compare = [&](Bicop cop) {
-      tools_interface::check_user_interrupt();
-      // Estimate the model
-      cop.fit(data_no_nan, controls);
-
-      // Compute the selection criterion
-      double new_criterion;
-      double ll = cop.get_loglik();
-      if (controls.get_selection_criterion() == "loglik") {
-        new_criterion = -ll;
-      } else if (controls.get_selection_criterion() == "aic") {
-        new_criterion = -2 * ll + 2 * cop.get_npars();
-      } else {
-        double n_eff = static_cast<double>(data_no_nan.rows());
-        if (controls.get_weights().size() > 0) {
-          n_eff = std::pow(controls.get_weights().sum(), 2);
-          n_eff /= controls.get_weights().array().pow(2).sum();
-        }
-        double npars = cop.get_npars();
-
-        new_criterion = -2 * ll + log(n_eff) * npars; // BIC
-        if (controls.get_selection_criterion() == "mbic") {
-          // correction for mBIC
-          bool is_indep = (cop.get_family() == BicopFamily::indep);
-          double psi0 = controls.get_psi0();
-          double log_prior = static_cast<double>(!is_indep) * log(psi0) +
-                             static_cast<double>(is_indep) * log(1.0 - psi0);
-          new_criterion -= 2 * log_prior;
-        }
-      }
-
-      // the following block modifies thread-external variables
-      // and is thus shielded by a mutex
-      {
-        std::lock_guard<std::mutex> lk(m);
-        // If the new model is better than the current one,
-        // then replace the current model by the new one
-        if (new_criterion < fitted_criterion) {
-          fitted_criterion = new_criterion;
-          bicop_ = cop.get_bicop();
-          rotation_ = cop.get_rotation();
-        }
-      }
-    };
 
-    tools_thread::ThreadPool pool(controls.get_num_threads());
-    pool.map(fit_and_compare, bicops);
-    pool.wait();
+  // fit all candidates and select the best one using the selection_criterion
+  BicopSelector selector(*this, data_no_nan, controls);
+  tools_thread::TaskGroup task_group(controls.get_num_threads());
+  if (selector.needs_pruning()) {
+    auto score_candidate = [&](size_t i) { selector.score_candidate(i); };
+    task_group.map(score_candidate,
+                   tools_stl::seq_int(0, selector.get_num_candidates()));
+    task_group.wait();
+    selector.prune_candidates();
   }
+  auto fit_candidate = [&](size_t i) { selector.fit_candidate(i); };
+  task_group.map(fit_candidate,
+                 tools_stl::seq_int(0, selector.get_num_candidates()));
+  task_group.wait();
+
+  *this = selector.get_selected();
+  num_skipped_fits_ = selector.get_num_skipped_fits();
+  num_objective_calls_ = selector.get_num_objective_calls();
 }
 
 //! @brief Adds an additional column if there's only one discrete variable;
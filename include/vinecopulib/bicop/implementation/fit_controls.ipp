@@ -114,6 +114,21 @@ inline FitControlsBicop::FitControlsBicop(const FitControlsConfig& config)
     if (optional::has_value(config.allow_rotations)) {
         set_allow_rotations(optional::value(config.allow_rotations));
     }
+    if (optional::has_value(config.warm_start)) {
+        set_warm_start(optional::value(config.warm_start));
+    }
+    if (optional::has_value(config.warm_start_neighbors)) {
+        set_warm_start_neighbors(optional::value(config.warm_start_neighbors));
+    }
+    if (optional::has_value(config.pruning_margin)) {
+        set_pruning_margin(optional::value(config.pruning_margin));
+    }
+    if (optional::has_value(config.cancellation_token)) {
+        set_cancellation_token(optional::value(config.cancellation_token));
+    }
+    if (optional::has_value(config.observer)) {
+        set_observer(optional::value(config.observer));
+    }
 }
 
 //! @name Sanity checks
@@ -163,6 +178,14 @@ FitControlsBicop::check_psi0(double psi0)
     throw std::runtime_error("psi0 must be in the interval (0, 1)");
   }
 }
+
+inline void
+FitControlsBicop::check_pruning_margin(double pruning_margin)
+{
+  if (!(pruning_margin >= 0.0)) {
+    throw std::runtime_error("pruning_margin must be non-negative");
+  }
+}
 //! @}
 
 //! @name Getters and setters.
@@ -237,6 +260,42 @@ FitControlsBicop::get_allow_rotations() const
   return allow_rotations_;
 }
 
+//! @brief Gets whether to use the current model as starting point.
+inline bool
+FitControlsBicop::get_warm_start() const
+{
+  return warm_start_;
+}
+
+//! @brief Gets whether a warm-started selection is restricted to the current
+//! family and its neighbors.
+inline bool
+FitControlsBicop::get_warm_start_neighbors() const
+{
+  return warm_start_neighbors_;
+}
+
+//! @brief Gets the margin for pruning candidates in `Bicop::select()`.
+inline double
+FitControlsBicop::get_pruning_margin() const
+{
+  return pruning_margin_;
+}
+
+//! @brief Gets the token to cancel fits (`nullptr` if there is none).
+inline std::shared_ptr<CancellationToken>
+FitControlsBicop::get_cancellation_token() const
+{
+  return cancellation_token_;
+}
+
+//! @brief Gets the observer of fits (`nullptr` if there is none).
+inline std::shared_ptr<Observer>
+FitControlsBicop::get_observer() const
+{
+  return observer_;
+}
+
 //! @brief Sets the family set.
 inline void
 FitControlsBicop::set_family_set(std::vector<BicopFamily> family_set)
@@ -313,6 +372,64 @@ FitControlsBicop::set_allow_rotations(bool allow_rotations)
   allow_rotations_ = allow_rotations;
 }
 
+//! @brief Sets whether to use the current model as starting point.
+//!
+//! @details If true, `Bicop::fit()` starts the optimization at the current
+//! parameters instead of the ones implied by Kendall's \f$ \tau \f$, and
+//! `Bicop::select()` does the same for the candidate matching the current
+//! family and rotation. This is useful when refitting a model to slightly
+//! changed data.
+inline void
+FitControlsBicop::set_warm_start(bool warm_start)
+{
+  warm_start_ = warm_start;
+}
+
+//! @brief Sets whether a warm-started selection is restricted to the current
+//! family and its neighbors.
+//!
+//! @details The neighbors of a family are the independence copula and
+//! the families that nest it or are nested by it (e.g., Clayton, Gumbel, and
+//! BB1). Only used if `warm_start = true`.
+inline void
+FitControlsBicop::set_warm_start_neighbors(bool warm_start_neighbors)
+{
+  warm_start_neighbors_ = warm_start_neighbors;
+}
+
+//! @brief Sets the margin for pruning candidates in `Bicop::select()`.
+//!
+//! @details If finite and `parametric_method = "mle"`, all parametric
+//! candidates are first scored by a cheap fit: by `"itau"` if available for
+//! the family, otherwise by `"mle"` with only a few evaluations of the
+//! likelihood. Candidates whose score exceeds the best one by more than
+//! `pruning_margin` are discarded before the `"mle"` fits.
+inline void
+FitControlsBicop::set_pruning_margin(double pruning_margin)
+{
+  check_pruning_margin(pruning_margin);
+  pruning_margin_ = pruning_margin;
+}
+
+//! @brief Sets a token to cancel fits.
+//!
+//! @details Fits using the controls check the token regularly (see
+//! `CancellationToken`).
+inline void
+FitControlsBicop::set_cancellation_token(
+  std::shared_ptr<CancellationToken> token)
+{
+  cancellation_token_ = token;
+}
+
+//! @brief Sets an observer that receives progress and timing events of fits
+//! (see `Observer`).
+inline void
+FitControlsBicop::set_observer(std::shared_ptr<Observer> observer)
+{
+  observer_ = observer;
+}
+
 inline size_t
 FitControlsBicop::process_num_threads(size_t num_threads)
 {
@@ -366,6 +483,10 @@ FitControlsBicop::str_internal(bool print_threads) const
                                                                     : "no")
                << std::endl;
   controls_str << "mBIC prior probability: " << get_psi0() << std::endl;
+  controls_str << "Warm start: "
+               << static_cast<std::string>(get_warm_start() ? "yes" : "no")
+               << std::endl;
+  controls_str << "Pruning margin: " << get_pruning_margin() << std::endl;
   if (print_threads) {
     controls_str << "Number of threads: "
                  << (get_num_threads() == 0 ? 1 : get_num_threads())
@@ -67,8 +67,12 @@ inline void
 ParBicop::fit(const Eigen::MatrixXd& data,
               std::string method,
               double,
-              const Eigen::VectorXd& weights)
+              const Eigen::VectorXd& weights,
+              bool warm_start,
+              double tau,
+              size_t maxeval)
 {
+  objective_calls_ = 0;
   // for independence copula we don't have to do anything
   if (family_ == BicopFamily::indep) {
     set_loglik(0.0);
@@ -76,7 +80,9 @@ ParBicop::fit(const Eigen::MatrixXd& data,
   }
 
   check_fit_method(method);
-  double tau = wdm::wdm(data, "tau", weights)(0, 1);
+  if (std::isnan(tau)) {
+    tau = wdm::wdm(data, "tau", weights)(0, 1);
+  }
 
   // for method itau and one-parameter families we don't need to optimize
   int npars = static_cast<int>(get_npars()) - (method == "itau");
@@ -91,6 +97,11 @@ ParBicop::fit(const Eigen::MatrixXd& data,
   auto ub = get_parameters_upper_bounds();
   adjust_parameters_bounds(lb, ub, tau, method);
   auto initial_parameters = get_start_parameters(winsorize_tau(tau));
+  if (warm_start && (method == "mle")) {
+    // start from the current parameters (moved inside the search interval)
+    Eigen::VectorXd current = get_parameters();
+    initial_parameters = current.cwiseMax(lb.col(0)).cwiseMin(ub.col(0));
+  }
 
   // find (pseudo-) mle
   std::function<double(const Eigen::VectorXd&)> objective;
@@ -114,6 +125,9 @@ ParBicop::fit(const Eigen::MatrixXd& data,
   }
 
   tools_optimization::Optimizer optimizer;
+  if (maxeval > 0) {
+    optimizer.set_controls(1e-4, 1e3, maxeval);
+  }
   auto newpars = optimizer.optimize(initial_parameters, lb, ub, objective);
 
   // check if fit is reasonable, otherwise increase search interval
@@ -136,6 +150,7 @@ ParBicop::fit(const Eigen::MatrixXd& data,
 
   set_parameters(newpars);
   set_loglik(optimizer.get_objective_max());
+  objective_calls_ = optimizer.get_objective_calls();
 }
 
 //! ensures that starting values are sufficiently separated from bounds
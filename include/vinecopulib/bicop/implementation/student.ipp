@@ -4,6 +4,7 @@
 // the MIT license. For a copy, see the LICENSE file in the root directory of
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
+#include <boost/math/special_functions/gamma.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
 
 namespace vinecopulib {
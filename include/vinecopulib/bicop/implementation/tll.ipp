@@ -5,6 +5,7 @@
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
 #include <vinecopulib/bicop/family.hpp>
+#include <vinecopulib/misc/tools_eigen.hpp>
 #include <vinecopulib/misc/tools_interpolation.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
 #include <wdm/eigen.hpp>
@@ -219,7 +220,10 @@ inline void
 TllBicop::fit(const Eigen::MatrixXd& data,
               std::string method,
               double mult,
-              const Eigen::VectorXd& weights)
+              const Eigen::VectorXd& weights,
+              bool,
+              double,
+              size_t)
 {
   using namespace tools_interpolation;
 
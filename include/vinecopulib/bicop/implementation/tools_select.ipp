@@ -4,12 +4,42 @@
 // the MIT license. For a copy, see the LICENSE file in the root directory of
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
+#include <limits>
+#include <vinecopulib/misc/tools_eigen.hpp>
+#include <vinecopulib/misc/tools_interface.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
 #include <vinecopulib/misc/tools_stl.hpp>
 #include <wdm/eigen.hpp>
 
 namespace vinecopulib {
 namespace tools_select {
+//! @brief Summarizes the dependence in the data of a pair copula.
+//! @param data Observations (only the first two columns are used).
+//! @param weights Vector of weights for each observation (can be empty).
+//! @param with_c1c2 Whether the correlations in the tail quadrants are
+//!   computed (they are only needed to preselect families).
+//! @param tau Kendall's tau of the data if already known (NaN otherwise).
+inline DependenceSummary
+summarize_dependence(const Eigen::MatrixXd& data,
+                     const Eigen::VectorXd& weights,
+                     bool with_c1c2,
+                     double tau)
+{
+  DependenceSummary summary;
+  summary.tau = tau;
+  if (std::isnan(summary.tau)) {
+    summary.tau = wdm::wdm(data.leftCols(2), "tau", weights)(0, 1);
+  }
+  if (with_c1c2) {
+    summary.c1c2 = get_c1c2(data.leftCols(2), summary.tau, weights);
+  }
+  summary.n_eff = static_cast<double>(data.rows());
+  if (weights.size() > 0) {
+    summary.n_eff = std::pow(weights.sum(), 2) / weights.array().pow(2).sum();
+  }
+  return summary;
+}
+
 //! @brief Gets only those rotations that yield the appropriate
 //! association direction.
 //! @param data Captured by reference to avoid data copies;
@@ -17,11 +47,26 @@ namespace tools_select {
 inline std::vector<Bicop>
 create_candidate_bicops(const Eigen::MatrixXd& data,
                         const FitControlsBicop& controls)
+{
+  auto summary = summarize_dependence(
+    data, controls.get_weights(), controls.get_preselect_families());
+  return create_candidate_bicops(controls, summary);
+}
+
+//! @brief Gets only those rotations that yield the appropriate
+//! association direction.
+//! @param controls See `Bicop::select()`.
+//! @param summary The dependence summary of the data; must contain the
+//!   correlations in the tail quadrants if `controls.get_preselect_families()`
+//!   is true.
+inline std::vector<Bicop>
+create_candidate_bicops(const FitControlsBicop& controls,
+                        const DependenceSummary& summary)
 {
   std::vector<BicopFamily> families = get_candidate_families(controls);
 
   // check whether dependence is negative or positive
-  double tau = wdm::wdm(data.leftCols(2), "tau", controls.get_weights())(0, 1);
+  double tau = summary.tau;
   std::vector<int> which_rotations;
   if (controls.get_allow_rotations()) {
     if (tau > 0) {
@@ -48,8 +93,7 @@ create_candidate_bicops(const Eigen::MatrixXd& data,
 
   // remove combinations based on symmetry characteristics
   if (controls.get_preselect_families()) {
-    preselect_candidates(
-      new_bicops, data.leftCols(2), tau, controls.get_weights());
+    preselect_candidates(new_bicops, summary);
   }
 
   return new_bicops;
@@ -79,6 +123,61 @@ get_candidate_families(const FitControlsBicop& controls)
   return family_set;
 }
 
+//! @brief Gets the families that are considered when a warm-started
+//! selection is restricted to the neighborhood of the current family.
+//!
+//! @details The neighbors are the family itself, the independence copula and
+//! all families that nest the family or are nested by it. For the independence
+//! copula, all families are returned.
+inline std::vector<BicopFamily>
+get_neighbor_families(BicopFamily family)
+{
+  std::vector<BicopFamily> neighbors;
+  switch (family) {
+    case BicopFamily::indep:
+      return bicop_families::all;
+    case BicopFamily::gaussian:
+      neighbors = { BicopFamily::student };
+      break;
+    case BicopFamily::student:
+      neighbors = { BicopFamily::gaussian };
+      break;
+    case BicopFamily::clayton:
+      neighbors = { BicopFamily::bb1, BicopFamily::bb7 };
+      break;
+    case BicopFamily::gumbel:
+      neighbors = { BicopFamily::bb1, BicopFamily::bb6, BicopFamily::tawn };
+      break;
+    case BicopFamily::frank:
+      neighbors = { BicopFamily::bb8 };
+      break;
+    case BicopFamily::joe:
+      neighbors = { BicopFamily::bb6, BicopFamily::bb7, BicopFamily::bb8 };
+      break;
+    case BicopFamily::bb1:
+      neighbors = { BicopFamily::clayton, BicopFamily::gumbel };
+      break;
+    case BicopFamily::bb6:
+      neighbors = { BicopFamily::gumbel, BicopFamily::joe };
+      break;
+    case BicopFamily::bb7:
+      neighbors = { BicopFamily::clayton, BicopFamily::joe };
+      break;
+    case BicopFamily::bb8:
+      neighbors = { BicopFamily::frank, BicopFamily::joe };
+      break;
+    case BicopFamily::tawn:
+      neighbors = { BicopFamily::gumbel };
+      break;
+    default:
+      break;
+  }
+  neighbors.push_back(family);
+  neighbors.push_back(BicopFamily::indep);
+
+  return neighbors;
+}
+
 //! removes candidates whose symmetry properties does not correspond to those
 //! of the data.
 inline void
@@ -87,11 +186,24 @@ preselect_candidates(std::vector<Bicop>& bicops,
                      double tau,
                      const Eigen::VectorXd& weights)
 {
-  auto c = get_c1c2(data, tau, weights);
+  DependenceSummary summary;
+  summary.tau = tau;
+  summary.c1c2 = get_c1c2(data, tau, weights);
+  summary.n_eff = std::numeric_limits<double>::quiet_NaN();
+  preselect_candidates(bicops, summary);
+}
+
+//! removes candidates whose symmetry properties does not correspond to those
+//! of the data summarized by `summary`.
+inline void
+preselect_candidates(std::vector<Bicop>& bicops,
+                     const DependenceSummary& summary)
+{
   bicops.erase(std::remove_if(bicops.begin(),
                               bicops.end(),
                               [&](const Bicop& cop) {
-                                return !(preselect_family(c, tau, cop));
+                                return !(preselect_family(
+                                  summary.c1c2, summary.tau, cop));
                               }),
                bicops.end());
 }
@@ -198,5 +310,242 @@ preselect_family(std::vector<double> c, double tau, const Bicop& bicop)
   }
   return preselect;
 }
+
+//! @brief Prepares the candidates for a selection.
+//! @param bicop The current model (used for its variable types and as a
+//!   starting point if `controls.get_warm_start()` is true).
+//! @param data See `Bicop::select()`.
+//! @param controls See `Bicop::select()`.
+//! @param tau Kendall's tau of the data without missing values if already
+//!   known, e.g., from the tree criterion of a vine (NaN otherwise).
+inline BicopSelector::BicopSelector(const Bicop& bicop,
+                                    const Eigen::MatrixXd& data,
+                                    FitControlsBicop controls,
+                                    double tau)
+  : data_(data)
+  , var_types_(bicop.get_var_types())
+  , old_family_(bicop.get_family())
+  , old_rotation_(bicop.get_rotation())
+{
+  auto w = controls.get_weights();
+  tools_eigen::remove_nans(data_, w);
+  controls.set_weights(w);
+
+  cold_controls_ = controls;
+  cold_controls_.set_warm_start(false);
+  if (controls.get_warm_start() && controls.get_warm_start_neighbors()) {
+    auto families = tools_stl::intersect(get_candidate_families(controls),
+                                         get_neighbor_families(old_family_));
+    if (!families.empty()) {
+      controls.set_family_set(families);
+    }
+  }
+  controls_ = controls;
+
+  if (data_.rows() >= 10) {
+    tools_eigen::trim(data_);
+    // all candidates share the dependence summary of the data
+    summary_ = summarize_dependence(data_,
+                                    controls_.get_weights(),
+                                    controls_.get_preselect_families(),
+                                    tau);
+    candidates_ = create_candidate_bicops(controls_, summary_);
+    Eigen::MatrixXd old_parameters = bicop.get_parameters();
+    for (auto& cop : candidates_) {
+      cop.set_var_types(var_types_);
+      if (is_old_model(cop)) {
+        cop.set_parameters(old_parameters);
+      }
+    }
+  }
+  scores_.assign(candidates_.size(), std::numeric_limits<double>::quiet_NaN());
+  criteria_ = scores_;
+  objective_calls_.assign(candidates_.size(), 0);
+  fit_seconds_.assign(candidates_.size(), 0.0);
+}
+
+//! @brief Gets the number of (remaining) candidates.
+inline size_t
+BicopSelector::get_num_candidates() const
+{
+  return candidates_.size();
+}
+
+//! @brief Checks whether candidates are scored and pruned before fitting
+//! (see `FitControlsBicop::set_pruning_margin()`).
+inline bool
+BicopSelector::needs_pruning() const
+{
+  return std::isfinite(controls_.get_pruning_margin()) &&
+         (controls_.get_parametric_method() == "mle");
+}
+
+//! @brief Scores a candidate by a cheap fit: by `"itau"` if available for the
+//! family, otherwise by `"mle"` with at most `score_maxeval` evaluations of
+//! the objective. Nonparametric candidates are not scored.
+inline void
+BicopSelector::score_candidate(size_t i)
+{
+  tools_interface::check_user_interrupt();
+  Bicop cop = candidates_[i];
+  if (!tools_stl::is_member(cop.get_family(), bicop_families::parametric)) {
+    return;
+  }
+  FitControlsBicop score_controls = cold_controls_;
+  size_t maxeval = 0;
+  if (tools_stl::is_member(cop.get_family(), bicop_families::itau)) {
+    score_controls.set_parametric_method("itau");
+  } else {
+    maxeval = score_maxeval;
+  }
+  ObserverTimer timer(controls_.get_observer().get());
+  cop.fit(data_, score_controls, summary_.tau, maxeval);
+  fit_seconds_[i] += timer.get_seconds();
+  objective_calls_[i] += cop.get_num_objective_calls();
+  scores_[i] = get_criterion(cop);
+}
+
+//! @brief Discards candidates whose score exceeds the best one by more than
+//! the pruning margin; must be called after all candidates are scored.
+inline void
+BicopSelector::prune_candidates()
+{
+  if (!needs_pruning()) {
+    return;
+  }
+
+  double best_score = std::numeric_limits<double>::infinity();
+  for (auto score : scores_) {
+    if (!std::isnan(score)) {
+      best_score = std::min(best_score, score);
+    }
+  }
+  double cutoff = best_score + controls_.get_pruning_margin();
+  std::vector<Bicop> kept_candidates;
+  std::vector<size_t> kept_objective_calls;
+  std::vector<double> kept_fit_seconds;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (!(scores_[i] > cutoff)) {
+      kept_candidates.push_back(candidates_[i]);
+      kept_objective_calls.push_back(objective_calls_[i]);
+      kept_fit_seconds.push_back(fit_seconds_[i]);
+    } else {
+      pruned_objective_calls_ += objective_calls_[i];
+      pruned_fit_seconds_ += fit_seconds_[i];
+    }
+  }
+  num_skipped_fits_ += candidates_.size() - kept_candidates.size();
+  candidates_ = kept_candidates;
+  objective_calls_ = kept_objective_calls;
+  fit_seconds_ = kept_fit_seconds;
+  scores_.assign(candidates_.size(), std::numeric_limits<double>::quiet_NaN());
+  criteria_ = scores_;
+}
+
+//! @brief Fits a candidate and computes its selection criterion.
+inline void
+BicopSelector::fit_candidate(size_t i)
+{
+  tools_interface::check_user_interrupt();
+  // only the current model is warm-started
+  auto& cop = candidates_[i];
+  ObserverTimer timer(controls_.get_observer().get());
+  cop.fit(
+    data_, is_old_model(cop) ? controls_ : cold_controls_, summary_.tau);
+  fit_seconds_[i] += timer.get_seconds();
+  objective_calls_[i] += cop.get_num_objective_calls();
+  criteria_[i] = get_criterion(cop);
+}
+
+//! @brief Gets the candidate with the best criterion; must be called after all
+//! candidates are fitted.
+//!
+//! @details Ties are broken in favor of the earlier candidate. If there are no
+//! candidates (less than 10 observations), the independence copula is
+//! returned.
+inline Bicop
+BicopSelector::get_selected() const
+{
+  double best_criterion = std::numeric_limits<double>::max();
+  size_t best = candidates_.size();
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (criteria_[i] < best_criterion) {
+      best_criterion = criteria_[i];
+      best = i;
+    }
+  }
+  if (best < candidates_.size()) {
+    return candidates_[best];
+  }
+
+  Bicop indep;
+  indep.set_var_types(var_types_);
+  indep.fit(data_, cold_controls_);
+  return indep;
+}
+
+//! @brief Gets the number of candidates discarded by `prune_candidates()`.
+inline size_t
+BicopSelector::get_num_skipped_fits() const
+{
+  return num_skipped_fits_;
+}
+
+//! @brief Gets the number of objective function evaluations of all fits
+//! (including those for scoring).
+inline size_t
+BicopSelector::get_num_objective_calls() const
+{
+  size_t calls = pruned_objective_calls_;
+  for (auto c : objective_calls_) {
+    calls += c;
+  }
+  return calls;
+}
+
+//! @brief Gets the summed wall time of all fits (0 without an observer, see
+//! `FitControlsBicop::set_observer()`).
+inline double
+BicopSelector::get_fit_seconds() const
+{
+  double seconds = pruned_fit_seconds_;
+  for (auto s : fit_seconds_) {
+    seconds += s;
+  }
+  return seconds;
+}
+
+inline double
+BicopSelector::get_criterion(const Bicop& bicop) const
+{
+  double criterion;
+  double ll = bicop.get_loglik();
+  if (controls_.get_selection_criterion() == "loglik") {
+    criterion = -ll;
+  } else if (controls_.get_selection_criterion() == "aic") {
+    criterion = -2 * ll + 2 * bicop.get_npars();
+  } else {
+    double n_eff = summary_.n_eff;
+    double npars = bicop.get_npars();
+
+    criterion = -2 * ll + log(n_eff) * npars; // BIC
+    if (controls_.get_selection_criterion() == "mbic") {
+      // correction for mBIC
+      bool is_indep = (bicop.get_family() == BicopFamily::indep);
+      double psi0 = controls_.get_psi0();
+      double log_prior = static_cast<double>(!is_indep) * log(psi0) +
+                         static_cast<double>(is_indep) * log(1.0 - psi0);
+      criterion -= 2 * log_prior;
+    }
+  }
+  return criterion;
+}
+
+inline bool
+BicopSelector::is_old_model(const Bicop& bicop) const
+{
+  return controls_.get_warm_start() && (bicop.get_family() == old_family_) &&
+         (bicop.get_rotation() == old_rotation_);
+}
 }
 }
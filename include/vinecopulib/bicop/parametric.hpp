@@ -37,7 +37,10 @@ protected:
   void fit(const Eigen::MatrixXd& data,
            std::string method,
            double,
-           const Eigen::VectorXd& weights);
+           const Eigen::VectorXd& weights,
+           bool warm_start,
+           double tau,
+           size_t maxeval);
 
   double get_npars() const;
 
@@ -48,7 +48,10 @@ private:
   void fit(const Eigen::MatrixXd& data,
            std::string method,
            double mult,
-           const Eigen::VectorXd& weights);
+           const Eigen::VectorXd& weights,
+           bool,
+           double,
+           size_t);
 };
 }
 
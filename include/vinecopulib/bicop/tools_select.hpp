@@ -7,25 +7,53 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <limits>
 #include <vector>
 #include <vinecopulib/bicop/class.hpp>
 
 namespace vinecopulib {
 namespace tools_select {
 
+//! @brief Summary of the dependence in the data of a pair copula, computed
+//! once per selection and shared by all candidates (see
+//! `summarize_dependence()`).
+struct DependenceSummary
+{
+  double tau;               // Kendall's tau
+  std::vector<double> c1c2; // see `get_c1c2()` (empty if not computed)
+  double n_eff;             // effective sample size
+};
+
+DependenceSummary
+summarize_dependence(const Eigen::MatrixXd& data,
+                     const Eigen::VectorXd& weights,
+                     bool with_c1c2 = true,
+                     double tau = std::numeric_limits<double>::quiet_NaN());
+
 std::vector<Bicop>
 create_candidate_bicops(const Eigen::MatrixXd& data,
                         const FitControlsBicop& controls);
 
+std::vector<Bicop>
+create_candidate_bicops(const FitControlsBicop& controls,
+                        const DependenceSummary& summary);
+
 std::vector<BicopFamily>
 get_candidate_families(const FitControlsBicop& controls);
 
+std::vector<BicopFamily>
+get_neighbor_families(BicopFamily family);
+
 void
 preselect_candidates(std::vector<Bicop>& bicops,
                      const Eigen::MatrixXd& data,
                      double tau,
                      const Eigen::VectorXd& weights);
 
+void
+preselect_candidates(std::vector<Bicop>& bicops,
+                     const DependenceSummary& summary);
+
 std::vector<double>
 get_c1c2(const Eigen::MatrixXd& data,
          double tau,
@@ -33,6 +61,66 @@ get_c1c2(const Eigen::MatrixXd& data,
 
 bool
 preselect_family(std::vector<double> c, double tau, const Bicop& bicop);
+
+//! @brief Splits the family selection of `Bicop::select()` into independent
+//! tasks.
+//!
+//! @details The candidates can be scored (`score_candidate()`) and fitted
+//! (`fit_candidate()`) in arbitrary order and from different threads, which
+//! allows to share one thread pool between several selections.
+class BicopSelector
+{
+public:
+  BicopSelector(const Bicop& bicop,
+                const Eigen::MatrixXd& data,
+                FitControlsBicop controls,
+                double tau = std::numeric_limits<double>::quiet_NaN());
+
+  size_t get_num_candidates() const;
+
+  bool needs_pruning() const;
+
+  void score_candidate(size_t i);
+
+  void prune_candidates();
+
+  void fit_candidate(size_t i);
+
+  Bicop get_selected() const;
+
+  size_t get_num_skipped_fits() const;
+
+  size_t get_num_objective_calls() const;
+
+  double get_fit_seconds() const;
+
+private:
+  // evaluations of the objective in the scoring fits of families without
+  // `"itau"`
+  static constexpr size_t score_maxeval = 40;
+
+  double get_criterion(const Bicop& bicop) const;
+
+  bool is_old_model(const Bicop& bicop) const;
+
+  Eigen::MatrixXd data_;
+  FitControlsBicop controls_;
+  FitControlsBicop cold_controls_;
+  DependenceSummary summary_;
+  std::vector<std::string> var_types_;
+  BicopFamily old_family_;
+  int old_rotation_;
+  std::vector<Bicop> candidates_;
+  std::vector<double> scores_;
+  std::vector<double> criteria_;
+  size_t num_skipped_fits_{ 0 };
+  // statistics of the fits by candidate (seconds only with an observer)
+  std::vector<size_t> objective_calls_;
+  std::vector<double> fit_seconds_;
+  // statistics of the scoring fits of pruned candidates
+  size_t pruned_objective_calls_{ 0 };
+  double pruned_fit_seconds_{ 0.0 };
+};
 }
 }
 
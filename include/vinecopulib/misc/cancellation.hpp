@@ -0,0 +1,94 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace vinecopulib {
+
+//! @brief Exception thrown when a computation is cancelled (see
+//! `CancellationToken`).
+class CancelledException : public std::runtime_error
+{
+public:
+  CancelledException()
+    : std::runtime_error("computation was cancelled")
+  {}
+};
+
+//! @brief A token to cancel long-running computations.
+//!
+//! @details A token is cancelled by calling `cancel()` (e.g., from another
+//! thread) or when its deadline has passed. Computations using the token (see
+//! `CancellationScope` and `FitControlsBicop::set_cancellation_token()`)
+//! check it regularly and stop by throwing a `CancelledException`.
+class CancellationToken
+{
+public:
+  CancellationToken() = default;
+  CancellationToken(const CancellationToken&) = delete;
+  CancellationToken& operator=(const CancellationToken&) = delete;
+
+  void cancel();
+  void set_deadline(std::chrono::steady_clock::time_point deadline);
+  template<class Rep, class Period>
+  void set_timeout(const std::chrono::duration<Rep, Period>& timeout);
+  bool is_cancelled() const;
+
+private:
+  using Ticks = std::chrono::steady_clock::rep;
+  std::atomic<bool> cancelled_{ false };
+  std::atomic<Ticks> deadline_{ std::numeric_limits<Ticks>::max() };
+};
+
+//! @brief Sets the cancellation token of the calling thread while in scope.
+//!
+//! @details All computations started in the scope check the token,
+//! including their work on other threads. Scopes can be nested; the innermost
+//! one with a token is used.
+//!
+//! @code
+//! auto token = std::make_shared<CancellationToken>();
+//! token->set_timeout(std::chrono::seconds(10));
+//! {
+//!   CancellationScope scope(token);
+//!   auto u = vc.simulate(1e6, false, 4);
+//! }
+//! @endcode
+class CancellationScope
+{
+public:
+  explicit CancellationScope(std::shared_ptr<CancellationToken> token);
+  ~CancellationScope();
+
+  CancellationScope(const CancellationScope&) = delete;
+  CancellationScope& operator=(const CancellationScope&) = delete;
+
+  static std::shared_ptr<CancellationToken> get_current();
+
+private:
+  static std::shared_ptr<CancellationToken>& current();
+
+  std::shared_ptr<CancellationToken> previous_;
+};
+
+//! @brief Sets the deadline to `timeout` from now.
+template<class Rep, class Period>
+void
+CancellationToken::set_timeout(const std::chrono::duration<Rep, Period>& timeout)
+{
+  set_deadline(
+    std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+}
+}
+
+#include <vinecopulib/misc/implementation/cancellation.ipp>
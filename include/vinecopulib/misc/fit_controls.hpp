@@ -8,7 +8,10 @@
 
 #include <Eigen/Dense>
 #include <vector>
+#include <memory>
 #include <string>
+#include <vinecopulib/misc/cancellation.hpp>
+#include <vinecopulib/misc/observer.hpp>
 #include <vinecopulib/misc/tools_optional.hpp>
 
 namespace vinecopulib {
@@ -49,6 +52,24 @@ struct FitControlsConfig {
     //! Number of threads to use during fitting. Default: 1.
     optional::optional<size_t> num_threads;
 
+    //! Whether to use the current model as starting point. Default: false.
+    optional::optional<bool> warm_start;
+
+    //! Whether a warm-started selection only considers the current family
+    //! and its neighbors. Default: false.
+    optional::optional<bool> warm_start_neighbors;
+
+    //! Margin by which the criterion of a candidate after a cheap `"itau"`
+    //! fit may exceed the best one before its full fit is skipped. Default:
+    //! infinity (no pruning).
+    optional::optional<double> pruning_margin;
+
+    //! Token to cancel the fit. Default: none.
+    optional::optional<std::shared_ptr<CancellationToken>> cancellation_token;
+
+    //! Observer receiving progress and timing events. Default: none.
+    optional::optional<std::shared_ptr<Observer>> observer;
+
     //! Truncation level for truncated vines. Default: no truncation.
     optional::optional<size_t> trunc_lvl;
 
@@ -0,0 +1,66 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+namespace vinecopulib {
+
+//! @brief Cancels all computations using the token.
+inline void
+CancellationToken::cancel()
+{
+  cancelled_ = true;
+}
+
+//! @brief Sets a deadline after which the token counts as cancelled.
+inline void
+CancellationToken::set_deadline(std::chrono::steady_clock::time_point deadline)
+{
+  deadline_ = deadline.time_since_epoch().count();
+}
+
+//! @brief Checks whether the token was cancelled or its deadline has passed.
+inline bool
+CancellationToken::is_cancelled() const
+{
+  if (cancelled_)
+    return true;
+  Ticks deadline = deadline_;
+  return (deadline != std::numeric_limits<Ticks>::max()) &&
+         (std::chrono::steady_clock::now().time_since_epoch().count() >=
+          deadline);
+}
+
+//! @brief Makes `token` the cancellation token of the calling thread.
+//! @param token The token; if `nullptr`, the current token is kept.
+inline CancellationScope::CancellationScope(
+  std::shared_ptr<CancellationToken> token)
+  : previous_(current())
+{
+  if (token) {
+    current() = std::move(token);
+  }
+}
+
+//! @brief Restores the previous token of the calling thread.
+inline CancellationScope::~CancellationScope()
+{
+  current() = std::move(previous_);
+}
+
+//! @brief Gets the cancellation token of the calling thread (`nullptr` if
+//! there is none).
+inline std::shared_ptr<CancellationToken>
+CancellationScope::get_current()
+{
+  return current();
+}
+
+inline std::shared_ptr<CancellationToken>&
+CancellationScope::current()
+{
+  static thread_local std::shared_ptr<CancellationToken> token;
+  return token;
+}
+}
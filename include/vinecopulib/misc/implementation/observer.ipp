@@ -0,0 +1,60 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+namespace vinecopulib {
+
+//! @brief Makes `observer` the observer of the calling thread.
+//! @param observer The observer; if `nullptr`, the current one is kept.
+inline ObserverScope::ObserverScope(std::shared_ptr<Observer> observer)
+  : previous_(current())
+{
+  if (observer) {
+    current() = std::move(observer);
+  }
+}
+
+//! @brief Restores the previous observer of the calling thread.
+inline ObserverScope::~ObserverScope()
+{
+  current() = std::move(previous_);
+}
+
+//! @brief Gets the observer of the calling thread (`nullptr` if there is
+//! none).
+inline std::shared_ptr<Observer>
+ObserverScope::get_current()
+{
+  return current();
+}
+
+inline std::shared_ptr<Observer>&
+ObserverScope::current()
+{
+  static thread_local std::shared_ptr<Observer> observer;
+  return observer;
+}
+
+//! @brief Starts the timer if `observer` is not `nullptr`.
+inline ObserverTimer::ObserverTimer(const Observer* observer)
+  : active_(observer != nullptr)
+{
+  if (active_) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+//! @brief Gets the seconds since construction (0 if the timer is inactive).
+inline double
+ObserverTimer::get_seconds() const
+{
+  if (!active_) {
+    return 0.0;
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start_;
+  return elapsed.count();
+}
+}
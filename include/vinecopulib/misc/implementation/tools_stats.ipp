@@ -4,11 +4,15 @@
 // the MIT license. For a copy, see the LICENSE file in the root directory of
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
-#include <boost/random.hpp>
-#include <boost/random/random_device.hpp>
-#include <boost/random/seed_seq.hpp>
+#include <array>
+#include <boost/math/distributions.hpp>
+#include <cstring>
 #include <memory>
-#include <unsupported/Eigen/FFT>
+#include <random>
+#include <unsupported/Eigen/SpecialFunctions>
+#include <vinecopulib/misc/tools_eigen.hpp>
+#include <vinecopulib/misc/tools_interface.hpp>
+#include <vinecopulib/misc/tools_random.hpp>
 #include <vinecopulib/misc/tools_stats_ghalton.hpp>
 #include <vinecopulib/misc/tools_stats_sobol.hpp>
 #include <vinecopulib/misc/tools_stl.hpp>
@@ -20,29 +24,113 @@ namespace vinecopulib {
 //! Utilities for statistical analysis
 namespace tools_stats {
 
+//! @brief Density function of the Standard normal distribution.
+//!
+//! @param x Evaluation points.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated densities.
+inline Eigen::MatrixXd
+dnorm(const Eigen::MatrixXd& x)
+{
+  static constexpr double inv_sqrt_2pi = 0.39894228040143270286;
+  return inv_sqrt_2pi * (-0.5 * x.array().square()).exp();
+}
+
+//! @brief Distribution function of the Standard normal distribution.
+//!
+//! @param x Evaluation points.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated probabilities.
+inline Eigen::MatrixXd
+pnorm(const Eigen::MatrixXd& x)
+{
+  static const double sqrt2 = std::sqrt(2.0);
+  return 0.5 * (1.0 + (x.array() / sqrt2).erf());
+}
+
+//! @brief Quantile function of the Standard normal distribution.
+//!
+//! @param x Evaluation points.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated quantiles.
+inline Eigen::MatrixXd
+qnorm(const Eigen::MatrixXd& x)
+{
+  return x.array().ndtri();
+}
+
+//! @brief Density function of the Student t distribution.
+//!
+//! @param x Evaluation points.
+//! @param nu Degrees of freedom parameter.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated densities.
+inline Eigen::MatrixXd
+dt(const Eigen::MatrixXd& x, double nu)
+{
+  boost::math::students_t dist(nu);
+  auto f = [&dist](double y) { return boost::math::pdf(dist, y); };
+  return tools_eigen::unaryExpr_or_nan(x, f);
+}
+
+//! @brief Distribution function of the Student t distribution.
+//!
+//! @param x Evaluation points.
+//! @param nu Degrees of freedom parameter.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated probabilities.
+inline Eigen::MatrixXd
+pt(const Eigen::MatrixXd& x, double nu)
+{
+  boost::math::students_t dist(nu);
+  auto f = [&dist](double y) { return boost::math::cdf(dist, y); };
+  return tools_eigen::unaryExpr_or_nan(x, f);
+}
+
+//! @brief Quantile function of the Student t distribution.
+//!
+//! @param x Evaluation points.
+//! @param nu Degrees of freedom parameter.
+//!
+//! @return An \f$ n \times d \f$ matrix of evaluated quantiles.
+inline Eigen::MatrixXd
+qt(const Eigen::MatrixXd& x, double nu)
+{
+  boost::math::students_t dist(nu);
+  auto f = [&dist](double y) { return boost::math::quantile(dist, y); };
+  return tools_eigen::unaryExpr_or_nan(x, f);
+}
+
 //! @brief Simulates from the multivariate uniform distribution.
 //!
 //! If `qrng = TRUE`, generalized Halton sequences (see `ghalton()`) are used
 //! for \f$ d \leq 300 \f$ and Sobol sequences otherwise (see `sobol()`).
+//! Otherwise, the numbers are drawn from a counter-based generator
+//! (`tools_random::Philox4x32`): the number in row \f$ i \f$ and column
+//! \f$ j \f$ only depends on the seeds, \f$ i \f$, and \f$ j \f$, so
+//! results do not depend on `num_threads`.
 //!
 //! @param n Number of observations.
 //! @param d Dimension.
 //! @param qrng If true, quasi-numbers are generated.
 //! @param seeds Seeds of the random number generator; if empty (default),
 //!   the random number generator is seeded randomly.
+//! @param num_threads The number of threads to use for generating the
+//!   numbers.
 //! @return An \f$ n \times d \f$ matrix of independent
 //! \f$ \mathrm{U}[0, 1] \f$ random variables.
 inline Eigen::MatrixXd
 simulate_uniform(const size_t& n,
                  const size_t& d,
                  bool qrng,
-                 std::vector<int> seeds)
+                 std::vector<int> seeds,
+                 size_t num_threads)
 {
   if (qrng) {
     if (d > 300) {
-      return tools_stats::sobol(n, d, seeds);
+      return tools_stats::sobol(n, d, seeds, num_threads);
     } else {
-      return tools_stats::ghalton(n, d, seeds);
+      return tools_stats::ghalton(n, d, seeds, num_threads);
     }
   }
   if ((n < 1) || (d < 1)) {
@@ -56,13 +144,33 @@ simulate_uniform(const size_t& n,
       seeds.begin(), seeds.end(), [&]() { return static_cast<int>(rd()); });
   }
 
-  // initialize random engine and uniform distribution
-  boost::random::seed_seq seq(seeds.begin(), seeds.end());
-  boost::random::mt19937 generator(seq);
-  boost::random::uniform_real_distribution<double> distribution(0.0, 1.0);
+  // the seeds select the key of the generator
+  std::seed_seq seq(seeds.begin(), seeds.end());
+  tools_random::Philox4x32::Key key;
+  seq.generate(key.begin(), key.end());
+  tools_random::Philox4x32 generator(key);
 
+  // one counter per row and pair of columns
   Eigen::MatrixXd u(n, d);
-  return u.unaryExpr([&](double) { return distribution(generator); });
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    for (size_t j = 0; j < d; j += 2) {
+      for (size_t i = b.begin; i < b.begin + b.size; ++i) {
+        auto bits = generator({ static_cast<uint32_t>(i),
+                                static_cast<uint32_t>(uint64_t{ i } >> 32),
+                                static_cast<uint32_t>(j / 2),
+                                0 });
+        u(i, j) = tools_random::to_unit_interval(bits[0], bits[1]);
+        if (j + 1 < d) {
+          u(i, j + 1) = tools_random::to_unit_interval(bits[2], bits[3]);
+        }
+      }
+    }
+  };
+  // a number costs about a tenth of a Gaussian density evaluation
+  size_t grain =
+    tools_batch::compute_min_batch_size(0.1 * static_cast<double>(d));
+  tools_thread::parallel_for(0, n, do_batch, num_threads, grain);
+  return u;
 }
 
 //! @brief Simulates from independendent normals.
@@ -84,6 +192,135 @@ simulate_normal(const size_t& n,
   return qnorm(tools_stats::simulate_uniform(n, d, qrng, seeds));
 }
 
+//! maps a number to an unsigned integer with the same order, such that
+//! numbers can be sorted by their bits; \f$ -0 \f$ and \f$ +0 \f$ are mapped
+//! to the same integer.
+inline uint64_t
+to_sortable_bits(double x)
+{
+  if (x == 0.0) {
+    x = 0.0;
+  }
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  // negative numbers are in reverse order, positive ones behind them
+  return (bits >> 63) ? ~bits : bits | (uint64_t{ 1 } << 63);
+}
+
+//! sorts `keys` and permutes `indices` alongside with a stable least
+//! significant digit radix sort (six passes of 11 bits).
+//!
+//! @details The histograms of all passes are computed in a single sweep over
+//! the keys, and passes in which all keys share the same digit are skipped.
+template<class Index>
+void
+radix_sort(std::vector<uint64_t>& keys, std::vector<Index>& indices)
+{
+  const int digit_bits = 11;
+  const int num_passes = 6;
+  const size_t num_digits = size_t{ 1 } << digit_bits;
+  const uint64_t mask = num_digits - 1;
+  size_t n = keys.size();
+  if (n == 0) {
+    return;
+  }
+
+  std::vector<size_t> counts(num_passes * num_digits, 0);
+  for (uint64_t key : keys) {
+    for (int pass = 0; pass < num_passes; ++pass) {
+      counts[pass * num_digits + ((key >> (pass * digit_bits)) & mask)]++;
+    }
+  }
+
+  std::vector<uint64_t> keys_tmp(n);
+  std::vector<Index> indices_tmp(n);
+  for (int pass = 0; pass < num_passes; ++pass) {
+    int shift = pass * digit_bits;
+    size_t* count = &counts[pass * num_digits];
+    if (count[(keys[0] >> shift) & mask] == n) {
+      continue;
+    }
+    size_t offset = 0;
+    for (size_t digit = 0; digit < num_digits; ++digit) {
+      size_t c = count[digit];
+      count[digit] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      size_t pos = count[(keys[i] >> shift) & mask]++;
+      keys_tmp[pos] = keys[i];
+      indices_tmp[pos] = indices[i];
+    }
+    keys.swap(keys_tmp);
+    indices.swap(indices_tmp);
+  }
+}
+
+//! ranks the non-missing entries of a vector by sorting them (with a radix
+//! sort for long vectors); `ties_method` must be one of `"average"`,
+//! `"min"`, `"max"`, or `"first"`. Missing values get rank NaN. `Index` is
+//! an unsigned integer type large enough to hold the length of `x`.
+template<class Index>
+Eigen::VectorXd
+rank_by_sorting(const Eigen::VectorXd& x, const std::string& ties_method)
+{
+  // below this length, a comparison sort is faster
+  const size_t min_radix_sort_size = 1024;
+
+  size_t n = static_cast<size_t>(x.size());
+  std::vector<uint64_t> keys;
+  std::vector<Index> indices;
+  keys.reserve(n);
+  indices.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (!std::isnan(x(i))) {
+      keys.push_back(to_sortable_bits(x(i)));
+      indices.push_back(static_cast<Index>(i));
+    }
+  }
+
+  size_t m = keys.size();
+  if (m >= min_radix_sort_size) {
+    radix_sort(keys, indices);
+  } else {
+    // sorting by (key, index) keeps equal keys in their original order
+    std::vector<std::pair<uint64_t, Index>> pairs(m);
+    for (size_t i = 0; i < m; ++i) {
+      pairs[i] = std::make_pair(keys[i], indices[i]);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    for (size_t i = 0; i < m; ++i) {
+      keys[i] = pairs[i].first;
+      indices[i] = pairs[i].second;
+    }
+  }
+
+  Eigen::VectorXd ranks = Eigen::VectorXd::Constant(
+    x.size(), std::numeric_limits<double>::quiet_NaN());
+  bool average = (ties_method == "average");
+  bool min = (ties_method == "min");
+  bool first = (ties_method == "first");
+  for (size_t begin = 0; begin < m;) {
+    // the sorted positions [begin, end) are tied
+    size_t end = begin + 1;
+    while ((end < m) && (keys[end] == keys[begin])) {
+      ++end;
+    }
+    double rank = static_cast<double>(end);
+    if (average) {
+      rank = 0.5 * static_cast<double>(begin + end + 1);
+    } else if (min) {
+      rank = static_cast<double>(begin + 1);
+    }
+    for (size_t k = begin; k < end; ++k) {
+      ranks(indices[k]) = first ? static_cast<double>(k + 1) : rank;
+    }
+    begin = end;
+  }
+
+  return ranks;
+}
+
 //! @brief Applies the empirical probability integral transform to a data
 //! matrix.
 //!
@@ -94,17 +331,30 @@ simulate_normal(const size_t& n,
 //! @param ties_method Indicates how to treat ties; same as in R, see
 //! https://stat.ethz.ch/R-manual/R-devel/library/base/html/rank.html.
 //! @param weights Vector of weights for the observations.
+//! @param seeds Seeds of the random number generator for
+//!   `ties_method = "random"`.
+//! @param num_threads The number of threads to use; columns are transformed
+//!   concurrently.
 //! @return Pseudo-observations of the copula, i.e. \f$ F_X(x) \f$
 //! (column-wise).
 inline Eigen::MatrixXd
 to_pseudo_obs(Eigen::MatrixXd x,
               const std::string& ties_method,
               const Eigen::VectorXd& weights,
-              std::vector<int> seeds)
+              std::vector<int> seeds,
+              size_t num_threads)
 {
-  for (int j = 0; j < x.cols(); ++j)
-    x.col(j) = to_pseudo_obs_1d(
-      static_cast<Eigen::VectorXd>(x.col(j)), ties_method, weights, seeds);
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    for (size_t j = b.begin; j < b.begin + b.size; ++j) {
+      x.col(j) = to_pseudo_obs_1d(
+        static_cast<Eigen::VectorXd>(x.col(j)), ties_method, weights, seeds);
+    }
+  };
+  // sorting costs a few density evaluations per observation
+  size_t grain =
+    tools_batch::compute_min_batch_size(5.0 * static_cast<double>(x.rows()));
+  tools_thread::parallel_for(
+    0, static_cast<size_t>(x.cols()), do_batch, num_threads, grain);
 
   return x;
 }
@@ -114,11 +364,15 @@ to_pseudo_obs(Eigen::MatrixXd x,
 //!
 //! Gives pseudo-observations from the copula by applying the empirical
 //! distribution function (scaled by \f$ n + 1 \f$) to each margin/column.
+//! Without weights and for the deterministic ties methods, the ranks are
+//! computed with a radix sort on the bits of the numbers.
 //!
 //! @param x A vector of real numbers.
 //! @param ties_method Indicates how to treat ties; same as in R, see
 //! https://stat.ethz.ch/R-manual/R-devel/library/base/html/rank.html.
 //! @param weights Vector of weights for the observations.
+//! @param seeds Seeds of the random number generator for
+//!   `ties_method = "random"`.
 //! @return Pseudo-observations of the copula, i.e. \f$ F_X(x) \f$.
 inline Eigen::VectorXd
 to_pseudo_obs_1d(Eigen::VectorXd x,
@@ -126,77 +380,424 @@ to_pseudo_obs_1d(Eigen::VectorXd x,
                  const Eigen::VectorXd& weights,
                  std::vector<int> seeds)
 {
-  size_t n = x.size();
-  auto xvec = wdm::utils::convert_vec(x);
-  auto res =
-    wdm::impl::rank(xvec, wdm::utils::convert_vec(weights), ties_method, seeds);
-  x = Eigen::Map<Eigen::VectorXd>(res.data(), res.size());
-
-  // correction for NaNs
-  if (wdm::utils::any_nan(xvec)) {
-    for (size_t i = 0; i < xvec.size(); i++) {
-      if (std::isnan(xvec[i])) {
-        n--;
-      }
+  // missing values are not counted
+  size_t n = static_cast<size_t>(x.size() - x.array().isNaN().count());
+
+  if ((weights.size() == 0) &&
+      tools_stl::is_member(ties_method, { "average", "min", "max", "first" })) {
+    if (x.size() <= std::numeric_limits<uint32_t>::max()) {
+      x = rank_by_sorting<uint32_t>(x, ties_method);
+    } else {
+      x = rank_by_sorting<size_t>(x, ties_method);
     }
+  } else {
+    auto res = wdm::impl::rank(wdm::utils::convert_vec(x),
+                               wdm::utils::convert_vec(weights),
+                               ties_method,
+                               seeds);
+    x = Eigen::Map<Eigen::VectorXd>(res.data(), res.size());
   }
 
   return x.array() / (static_cast<double>(n) + 1.0);
 }
 
+//! @brief Creates an empty tree.
+inline OrderStatisticTree::OrderStatisticTree()
+  : root_(-1)
+  , state_(2463534242)
+{
+}
+
+//! @brief Inserts a value.
+inline void
+OrderStatisticTree::insert(double value)
+{
+  if (std::isnan(value)) {
+    throw std::runtime_error("cannot insert NaN into the tree.");
+  }
+  root_ = this->insert(root_, value);
+}
+
+//! @brief Removes one element equal to a value.
+inline void
+OrderStatisticTree::erase(double value)
+{
+  root_ = this->erase(root_, value);
+}
+
+//! @brief Removes all elements.
+inline void
+OrderStatisticTree::clear()
+{
+  nodes_.clear();
+  free_nodes_.clear();
+  root_ = -1;
+}
+
+//! @brief Gets the number of elements.
+inline size_t
+OrderStatisticTree::size() const
+{
+  return get_size(root_);
+}
+
+//! @brief Counts the elements smaller than a value.
+inline size_t
+OrderStatisticTree::count_less(double value) const
+{
+  size_t less = 0;
+  ptrdiff_t t = root_;
+  while (t >= 0) {
+    const Node& node = nodes_[t];
+    if (value < node.value) {
+      t = node.left;
+    } else if (value > node.value) {
+      less += get_size(node.left) + node.count;
+      t = node.right;
+    } else {
+      return less + get_size(node.left);
+    }
+  }
+  return less;
+}
+
+//! @brief Counts the elements equal to a value.
+inline size_t
+OrderStatisticTree::count(double value) const
+{
+  ptrdiff_t t = root_;
+  while (t >= 0) {
+    const Node& node = nodes_[t];
+    if (value < node.value) {
+      t = node.left;
+    } else if (value > node.value) {
+      t = node.right;
+    } else {
+      return node.count;
+    }
+  }
+  return 0;
+}
+
+inline size_t
+OrderStatisticTree::get_size(ptrdiff_t t) const
+{
+  return (t < 0) ? 0 : nodes_[t].size;
+}
+
+inline void
+OrderStatisticTree::update_size(ptrdiff_t t)
+{
+  nodes_[t].size =
+    get_size(nodes_[t].left) + nodes_[t].count + get_size(nodes_[t].right);
+}
+
+inline ptrdiff_t
+OrderStatisticTree::rotate_left(ptrdiff_t t)
+{
+  ptrdiff_t r = nodes_[t].right;
+  nodes_[t].right = nodes_[r].left;
+  nodes_[r].left = t;
+  update_size(t);
+  update_size(r);
+  return r;
+}
+
+inline ptrdiff_t
+OrderStatisticTree::rotate_right(ptrdiff_t t)
+{
+  ptrdiff_t l = nodes_[t].left;
+  nodes_[t].left = nodes_[l].right;
+  nodes_[l].right = t;
+  update_size(t);
+  update_size(l);
+  return l;
+}
+
+//! inserts `value` into the subtree rooted at `t` and returns the new root.
+inline ptrdiff_t
+OrderStatisticTree::insert(ptrdiff_t t, double value)
+{
+  if (t < 0) {
+    // xorshift generator for the priorities
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    Node node{ value, 1, 1, state_, -1, -1 };
+    if (free_nodes_.empty()) {
+      nodes_.push_back(node);
+      return static_cast<ptrdiff_t>(nodes_.size()) - 1;
+    }
+    t = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[t] = node;
+    return t;
+  }
+
+  // the child is inserted first, since it may reallocate the nodes
+  if (value < nodes_[t].value) {
+    ptrdiff_t child = this->insert(nodes_[t].left, value);
+    nodes_[t].left = child;
+    if (nodes_[child].weight > nodes_[t].weight) {
+      return rotate_right(t);
+    }
+  } else if (value > nodes_[t].value) {
+    ptrdiff_t child = this->insert(nodes_[t].right, value);
+    nodes_[t].right = child;
+    if (nodes_[child].weight > nodes_[t].weight) {
+      return rotate_left(t);
+    }
+  } else {
+    nodes_[t].count++;
+  }
+  update_size(t);
+  return t;
+}
+
+//! removes one element equal to `value` from the subtree rooted at `t` and
+//! returns the new root.
+inline ptrdiff_t
+OrderStatisticTree::erase(ptrdiff_t t, double value)
+{
+  if (t < 0) {
+    throw std::runtime_error("value is not in the tree.");
+  }
+  Node& node = nodes_[t];
+  if (value < node.value) {
+    node.left = this->erase(node.left, value);
+  } else if (value > node.value) {
+    node.right = this->erase(node.right, value);
+  } else if (node.count > 1) {
+    node.count--;
+  } else if ((node.left < 0) || (node.right < 0)) {
+    // at most one child, which takes the place of the node
+    ptrdiff_t child = (node.left < 0) ? node.right : node.left;
+    free_nodes_.push_back(t);
+    return child;
+  } else {
+    // move the node down below the child with the larger priority
+    if (nodes_[node.left].weight > nodes_[node.right].weight) {
+      t = rotate_right(t);
+      nodes_[t].right = this->erase(nodes_[t].right, value);
+    } else {
+      t = rotate_left(t);
+      nodes_[t].left = this->erase(nodes_[t].left, value);
+    }
+  }
+  update_size(t);
+  return t;
+}
+
+//! @brief Creates an empty set of observations.
+//!
+//! @param d The number of variables.
+//! @param ties_method Indicates how to treat ties; one of `"average"`,
+//!   `"min"`, and `"max"` (see `to_pseudo_obs()`).
+inline OnlinePseudoObs::OnlinePseudoObs(size_t d,
+                                        const std::string& ties_method)
+  : ties_method_(ties_method)
+  , n_(0)
+  , trees_(d)
+{
+  if ((ties_method != "average") && (ties_method != "min") &&
+      (ties_method != "max")) {
+    throw std::runtime_error(
+      "ties_method must be one of 'average', 'min', and 'max'.");
+  }
+}
+
+//! @brief Adds observations.
+//!
+//! @details Takes \f$ O(\log n) \f$ time per observation and variable. NaNs
+//! are ignored, i.e., they do not count as observations of their variable.
+//! @param x An \f$ m \times d \f$ matrix of new observations.
+inline void
+OnlinePseudoObs::insert(const Eigen::MatrixXd& x)
+{
+  check_dim(x);
+  for (Eigen::Index j = 0; j < x.cols(); ++j) {
+    for (Eigen::Index i = 0; i < x.rows(); ++i) {
+      if (!std::isnan(x(i, j))) {
+        trees_[j].insert(x(i, j));
+      }
+    }
+  }
+  n_ += static_cast<size_t>(x.rows());
+}
+
+//! @brief Removes observations that have been added before.
+//!
+//! @details Takes \f$ O(\log n) \f$ time per observation and variable. If
+//! one of the values has not been added (as often as it appears in `x`), an
+//! error is thrown and nothing is removed.
+//! @param x An \f$ m \times d \f$ matrix of observations to remove.
+inline void
+OnlinePseudoObs::erase(const Eigen::MatrixXd& x)
+{
+  check_dim(x);
+  if (static_cast<size_t>(x.rows()) > n_) {
+    throw std::runtime_error("cannot remove more observations than added.");
+  }
+  // check all values before modifying any tree
+  std::vector<double> values;
+  for (Eigen::Index j = 0; j < x.cols(); ++j) {
+    values.clear();
+    for (Eigen::Index i = 0; i < x.rows(); ++i) {
+      if (!std::isnan(x(i, j))) {
+        values.push_back(x(i, j));
+      }
+    }
+    std::sort(values.begin(), values.end());
+    for (size_t i = 0; i < values.size();) {
+      size_t k = i + 1;
+      while ((k < values.size()) && (values[k] == values[i])) {
+        ++k;
+      }
+      if (trees_[j].count(values[i]) < k - i) {
+        throw std::runtime_error("value is not in the tree.");
+      }
+      i = k;
+    }
+  }
+
+  for (Eigen::Index j = 0; j < x.cols(); ++j) {
+    for (Eigen::Index i = 0; i < x.rows(); ++i) {
+      if (!std::isnan(x(i, j))) {
+        trees_[j].erase(x(i, j));
+      }
+    }
+  }
+  n_ -= static_cast<size_t>(x.rows());
+}
+
+//! @brief Removes all observations.
+inline void
+OnlinePseudoObs::clear()
+{
+  for (auto& tree : trees_) {
+    tree.clear();
+  }
+  n_ = 0;
+}
+
+//! @brief Gets the number of variables.
+inline size_t
+OnlinePseudoObs::get_dim() const
+{
+  return trees_.size();
+}
+
+//! @brief Gets the number of observations.
+inline size_t
+OnlinePseudoObs::get_n() const
+{
+  return n_;
+}
+
+//! @brief Computes pseudo-observations.
+//!
+//! @details For each variable, the rank of a value among the current
+//! observations is scaled by \f$ n + 1 \f$, where \f$ n \f$ is the number of
+//! non-missing observations. For the current observations, the result equals
+//! `to_pseudo_obs()` applied to all of them. Values that are not among the
+//! observations get the rank they would have if they were added. Takes
+//! \f$ O(\log n) \f$ time per value.
+//! @param x An \f$ m \times d \f$ matrix of values.
+//! @return An \f$ m \times d \f$ matrix of pseudo-observations (NaN where
+//!   `x` is NaN).
+inline Eigen::MatrixXd
+OnlinePseudoObs::get_pseudo_obs(const Eigen::MatrixXd& x) const
+{
+  check_dim(x);
+  Eigen::MatrixXd u(x.rows(), x.cols());
+  for (Eigen::Index j = 0; j < x.cols(); ++j) {
+    const OrderStatisticTree& tree = trees_[j];
+    double scale = static_cast<double>(tree.size()) + 1.0;
+    for (Eigen::Index i = 0; i < x.rows(); ++i) {
+      if (std::isnan(x(i, j))) {
+        u(i, j) = std::numeric_limits<double>::quiet_NaN();
+        continue;
+      }
+      double less = static_cast<double>(tree.count_less(x(i, j)));
+      double ties = static_cast<double>(std::max(tree.count(x(i, j)),
+                                                 static_cast<size_t>(1)));
+      double rank;
+      if (ties_method_ == "average") {
+        rank = less + (ties + 1) / 2;
+      } else if (ties_method_ == "min") {
+        rank = less + 1;
+      } else {
+        rank = less + ties;
+      }
+      u(i, j) = rank / scale;
+    }
+  }
+  return u;
+}
+
+inline void
+OnlinePseudoObs::check_dim(const Eigen::MatrixXd& x) const
+{
+  if (static_cast<size_t>(x.cols()) != trees_.size()) {
+    throw std::runtime_error("x must have " + std::to_string(trees_.size()) +
+                             " columns.");
+  }
+}
+
 // Construct a box covering from a matrix of samples.
 // @param u A matrix of samples.
-// @param K The number of boxes in each dimension.
+// @param K The number of cells in each dimension.
 inline BoxCovering::BoxCovering(const Eigen::MatrixXd& u, uint16_t K)
-  : u_(u)
+  : n_(u.rows())
   , K_(K)
+  , samples_(n_)
+  , cells_(n_)
+  , first_(static_cast<size_t>(K) * K, -1)
+  , cell_counts_(static_cast<size_t>(K) * K, 0)
+  , row_counts_(static_cast<size_t>(K) * (K + 1), 0)
 {
-  boxes_.resize(K);
-  for (size_t k = 0; k < K; k++) {
-    boxes_[k].resize(K);
-    for (size_t j = 0; j < K; j++) {
-      boxes_[k][j] = std::make_unique<Box>(
-        std::vector<double>{ static_cast<double>(k) / K,
-                             static_cast<double>(j) / K },
-        std::vector<double>{ static_cast<double>(k + 1) / K,
-                             static_cast<double>(j + 1) / K });
-    }
-  }
-
-  n_ = u.rows();
+  // samples are appended to their cells in the order of their indices
+  std::vector<ptrdiff_t> last(first_.size(), -1);
   for (size_t i = 0; i < n_; i++) {
-    size_t k = static_cast<size_t>(std::floor(u(i, 0) * K));
-    size_t j = static_cast<size_t>(std::floor(u(i, 1) * K));
-    boxes_[k][j]->indices_.insert(i);
+    samples_[i].u0 = u(i, 0);
+    samples_[i].u1 = u(i, 1);
+    cells_[i] = get_cell(i);
+    ptrdiff_t& prev = last[cells_[i]];
+    samples_[i].prev = prev;
+    samples_[i].next = -1;
+    if (prev >= 0) {
+      samples_[prev].next = static_cast<ptrdiff_t>(i);
+    } else {
+      first_[cells_[i]] = static_cast<ptrdiff_t>(i);
+    }
+    prev = static_cast<ptrdiff_t>(i);
+    update_counts(cells_[i], true);
   }
 }
 
-// Get the indices of the samples in a box defined by lower and upper bounds.
+// Get the indices of the samples in a box.
 // @param lower Lower bounds of the box.
 // @param upper Upper bounds of the box.
+// @return The indices of the samples in the box, ordered by cells (row by row)
+//   and by index within a cell.
 inline std::vector<size_t>
 BoxCovering::get_box_indices(const Eigen::VectorXd& lower,
                              const Eigen::VectorXd& upper) const
 {
   std::vector<size_t> indices;
-  indices.reserve(n_);
-  auto l0 = static_cast<size_t>(std::floor(lower(0) * K_));
-  auto l1 = static_cast<size_t>(std::floor(lower(1) * K_));
-  auto u0 = static_cast<size_t>(std::ceil(upper(0) * K_));
-  auto u1 = static_cast<size_t>(std::ceil(upper(1) * K_));
+  size_t l0 = get_cell_bound(lower(0), false);
+  size_t l1 = get_cell_bound(lower(1), false);
+  size_t u0 = get_cell_bound(upper(0), true);
+  size_t u1 = get_cell_bound(upper(1), true);
 
   for (size_t k = l0; k < u0; k++) {
     for (size_t j = l1; j < u1; j++) {
-      for (auto& i : boxes_[k][j]->indices_) {
-        if ((k == l0) || (k == u0 - 1)) {
-          if ((u_(i, 0) < lower(0)) || (u_(i, 0) > upper(0)))
-            continue;
+      // samples in the cells on the boundary of the box must be checked
+      bool check = (k == l0) || (k + 1 == u0) || (j == l1) || (j + 1 == u1);
+      for (ptrdiff_t i = first_[k * K_ + j]; i >= 0; i = samples_[i].next) {
+        if (!check || is_in_box(static_cast<size_t>(i), lower, upper)) {
+          indices.push_back(static_cast<size_t>(i));
         }
-        if ((j == l1) || (j == u1 - 1)) {
-          if ((u_(i, 1) < lower(1)) || (u_(i, 1) > upper(1)))
-            continue;
-        }
-        indices.push_back(i);
       }
     }
   }
@@ -204,27 +805,181 @@ BoxCovering::get_box_indices(const Eigen::VectorXd& lower,
   return indices;
 }
 
-// Swap a sample in the box covering.
-// @param i Index of the sample to swap.
+// Select one of the samples in a box without collecting all of them.
+// @param lower Lower bounds of the box.
+// @param upper Upper bounds of the box.
+// @param w A number in [0, 1); the sample at position floor(w * m) of the m
+//   samples in the box (in the order of `get_box_indices()`) is selected.
+// @return The index of the selected sample, or -1 if the box is empty.
+inline ptrdiff_t
+BoxCovering::sample_box_index(const Eigen::VectorXd& lower,
+                              const Eigen::VectorXd& upper,
+                              double w) const
+{
+  size_t l0 = get_cell_bound(lower(0), false);
+  size_t l1 = get_cell_bound(lower(1), false);
+  size_t u0 = get_cell_bound(upper(0), true);
+  size_t u1 = get_cell_bound(upper(1), true);
+  if ((l0 >= u0) || (l1 >= u1)) {
+    return -1;
+  }
+
+  // only the samples in the cells on the boundary of the box are checked, the
+  // interior cells of a row are counted at once
+  auto count_cell = [&](size_t cell) {
+    size_t count = 0;
+    for (ptrdiff_t i = first_[cell]; i >= 0; i = samples_[i].next) {
+      count += is_in_box(static_cast<size_t>(i), lower, upper);
+    }
+    return count;
+  };
+  std::vector<size_t> row_totals(u0 - l0, 0);
+  size_t total = 0;
+  for (size_t k = l0; k < u0; k++) {
+    size_t& row_total = row_totals[k - l0];
+    if ((k == l0) || (k + 1 == u0) || (u1 - l1 <= 2)) {
+      for (size_t j = l1; j < u1; j++) {
+        row_total += count_cell(k * K_ + j);
+      }
+    } else {
+      row_total = count_cell(k * K_ + l1) + count_cell(k * K_ + u1 - 1) +
+                  count_row(k, u1 - 1) - count_row(k, l1 + 1);
+    }
+    total += row_total;
+  }
+  if (total == 0) {
+    return -1;
+  }
+
+  size_t m = std::min(static_cast<size_t>(w * static_cast<double>(total)),
+                      total - 1);
+  size_t k = l0;
+  while (m >= row_totals[k - l0]) {
+    m -= row_totals[k - l0];
+    k++;
+  }
+  for (size_t j = l1; j < u1; j++) {
+    size_t cell = k * K_ + j;
+    bool check = (k == l0) || (k + 1 == u0) || (j == l1) || (j + 1 == u1);
+    if (!check && (m >= cell_counts_[cell])) {
+      m -= cell_counts_[cell];
+      continue;
+    }
+    for (ptrdiff_t i = first_[cell]; i >= 0; i = samples_[i].next) {
+      if ((!check || is_in_box(static_cast<size_t>(i), lower, upper)) &&
+          (m-- == 0)) {
+        return i;
+      }
+    }
+  }
+  return -1; // not reached
+}
+
+// Move a sample to a new position.
+// @param i Index of the sample to move.
+// @param new_sample The new position of the sample.
 inline void
 BoxCovering::swap_sample(size_t i, const Eigen::VectorXd& new_sample)
 {
-  auto k = static_cast<size_t>(std::floor(u_(i, 0) * K_));
-  auto j = static_cast<size_t>(std::floor(u_(i, 1) * K_));
-  boxes_[k][j]->indices_.erase(i);
+  // remove from the old cell
+  Sample& sample = samples_[i];
+  size_t cell = cells_[i];
+  if (sample.prev >= 0) {
+    samples_[sample.prev].next = sample.next;
+  } else {
+    first_[cell] = sample.next;
+  }
+  if (sample.next >= 0) {
+    samples_[sample.next].prev = sample.prev;
+  }
+  update_counts(cell, false);
+
+  // insert into the new cell, keeping the indices sorted
+  sample.u0 = new_sample(0);
+  sample.u1 = new_sample(1);
+  cell = cells_[i] = get_cell(i);
+  ptrdiff_t prev = -1;
+  ptrdiff_t next = first_[cell];
+  while ((next >= 0) && (static_cast<size_t>(next) < i)) {
+    prev = next;
+    next = samples_[next].next;
+  }
+  sample.prev = prev;
+  sample.next = next;
+  if (prev >= 0) {
+    samples_[prev].next = static_cast<ptrdiff_t>(i);
+  } else {
+    first_[cell] = static_cast<ptrdiff_t>(i);
+  }
+  if (next >= 0) {
+    samples_[next].prev = static_cast<ptrdiff_t>(i);
+  }
+  update_counts(cell, true);
+}
+
+// Get the index of the first cell above (upper = false) or the first cell
+// after (upper = true) a coordinate.
+inline size_t
+BoxCovering::get_cell_bound(double u, bool upper) const
+{
+  double K = static_cast<double>(K_);
+  double bound = upper ? std::ceil(u * K) : std::floor(u * K);
+  return static_cast<size_t>(std::min(std::max(bound, 0.0), K));
+}
+
+// Get the cell (row-major) of a sample.
+inline size_t
+BoxCovering::get_cell(size_t i) const
+{
+  size_t k = std::min(get_cell_bound(samples_[i].u0, false), K_ - size_t{ 1 });
+  size_t j =
+    std::min(get_cell_bound(samples_[i].u1, false), K_ - size_t{ 1 });
+  return k * K_ + j;
+}
+
+// Add (add = true) or remove a sample from the counts of a cell; the counts
+// of each row are stored in a Fenwick tree.
+inline void
+BoxCovering::update_counts(size_t cell, bool add)
+{
+  size_t K1 = static_cast<size_t>(K_) + 1;
+  size_t k = cell / K_;
+  if (add) {
+    cell_counts_[cell]++;
+  } else {
+    cell_counts_[cell]--;
+  }
+  for (size_t j = cell % K_ + 1; j < K1; j += j & (~j + 1)) {
+    if (add) {
+      row_counts_[k * K1 + j]++;
+    } else {
+      row_counts_[k * K1 + j]--;
+    }
+  }
+}
 
-  u_.row(i) = new_sample;
-  k = static_cast<size_t>(std::floor(new_sample(0) * K_));
-  j = static_cast<size_t>(std::floor(new_sample(1) * K_));
-  boxes_[k][j]->indices_.insert(i);
+// Count the samples in the cells [0, j) of row k.
+inline size_t
+BoxCovering::count_row(size_t k, size_t j) const
+{
+  size_t K1 = static_cast<size_t>(K_) + 1;
+  size_t count = 0;
+  for (; j > 0; j -= j & (~j + 1)) {
+    count += row_counts_[k * K1 + j];
+  }
+  return count;
 }
 
-//! Create a single box.
-inline BoxCovering::Box::Box(const std::vector<double>& lower,
-                             const std::vector<double>& upper)
-  : lower_(lower)
-  , upper_(upper)
+// Check whether a sample is in a box.
+inline bool
+BoxCovering::is_in_box(size_t i,
+                       const Eigen::VectorXd& lower,
+                       const Eigen::VectorXd& upper) const
 {
+  double u0 = samples_[i].u0;
+  double u1 = samples_[i].u1;
+  return (u0 >= lower(0)) && (u0 <= upper(0)) && (u1 >= lower(1)) &&
+         (u1 <= upper(1));
 }
 
 // Recovers a (continuous) latent sample from a sample of a discrete copula by
@@ -232,8 +987,13 @@ inline BoxCovering::Box::Box(const std::vector<double>& lower,
 // @param u A matrix of samples.
 // @param b The bandwidth of the kernel density estimator.
 // @param niter The number of iterations.
+// @param num_threads The number of threads used for computing the ranks in
+//   each iteration; the latent samples are updated one after another.
 inline Eigen::MatrixXd
-find_latent_sample(const Eigen::MatrixXd& u, double b, size_t niter)
+find_latent_sample(const Eigen::MatrixXd& u,
+                   double b,
+                   size_t niter,
+                   size_t num_threads)
 {
   using namespace tools_stats;
   size_t n = u.rows();
@@ -245,8 +1005,10 @@ find_latent_sample(const Eigen::MatrixXd& u, double b, size_t niter)
   Eigen::MatrixXd uu = w.array() * u.leftCols(2).array() +
                        (1 - w.array()) * u.rightCols(2).array();
 
-  auto covering = BoxCovering(uu);
-  std::vector<size_t> indices;
+  // about one sample per cell, so that few samples are checked per query
+  auto K = static_cast<uint16_t>(std::min(
+    std::max(std::ceil(std::sqrt(static_cast<double>(n))), 40.0), 2048.0));
+  BoxCovering covering(uu, K);
 
   Eigen::MatrixXd lb = qnorm(u.rightCols(2));
   Eigen::MatrixXd ub = qnorm(u.leftCols(2));
@@ -254,18 +1016,19 @@ find_latent_sample(const Eigen::MatrixXd& u, double b, size_t niter)
   ub = pnorm(ub.array() + b);
 
   Eigen::MatrixXd x(n, 2), norm_sim(n, 2);
+  Eigen::VectorXd lower(2), upper(2);
 
   for (uint16_t it = 0; it < niter; it++) {
-    uu = to_pseudo_obs(uu);
+    uu = to_pseudo_obs(uu, "average", Eigen::VectorXd(), {}, num_threads);
     x = qnorm(uu);
     norm_sim = simulate_normal(n, 2, true, { it, 5 }).array() * b;
     w = simulate_uniform(n, 1, true, { it, 55 });
 
     for (size_t i = 0; i < n; i++) {
-      indices = covering.get_box_indices(lb.row(i), ub.row(i));
-      double n_idx = static_cast<double>(indices.size());
-      if (n_idx > 0) {
-        size_t j = indices.at(static_cast<size_t>(w(i) * n_idx));
+      lower = lb.row(i);
+      upper = ub.row(i);
+      ptrdiff_t j = covering.sample_box_index(lower, upper, w(i));
+      if (j >= 0) {
         x.row(i) = x.row(j) + norm_sim.row(i);
         uu.row(i) = pnorm(x.row(i));
         covering.swap_sample(i, uu.row(i));
@@ -276,65 +1039,107 @@ find_latent_sample(const Eigen::MatrixXd& u, double b, size_t niter)
   return to_pseudo_obs(x);
 }
 
+//! window smoother: averages over windows of `2 * wl + 1` neighbors, computed
+//! as running sums; the first and last `wl` values are those of the closest
+//! full window.
+//! @param x The values to smooth.
+//! @param wl The half-width of the windows.
+//! @param result A vector of the same size as `x` the result is written to.
+inline void
+win(const Eigen::VectorXd& x, size_t wl, Eigen::VectorXd& result)
+{
+  size_t n = x.size();
+  if (n == 0) {
+    return;
+  }
+  wl = std::min(wl, (n - 1) / 2);
+  double width = 2.0 * static_cast<double>(wl) + 1.0;
+  double sum = x.head(2 * wl + 1).sum();
+  result(wl) = sum / width;
+  for (size_t i = wl + 1; i < n - wl; i++) {
+    sum += x(i + wl) - x(i - wl - 1);
+    result(i) = sum / width;
+  }
+  result.head(wl).setConstant(result(wl));
+  result.tail(wl).setConstant(result(n - wl - 1));
+}
+
 //! window smoother
 inline Eigen::VectorXd
 win(const Eigen::VectorXd& x, size_t wl = 5)
 {
-  size_t n = x.size();
-  Eigen::VectorXd xx = Eigen::VectorXd::Zero(n + 2 * wl);
-  Eigen::VectorXd yy = Eigen::VectorXd::Zero(n + 2 * wl);
-  xx.block(2 * wl, 0, n, 1) = x;
-  yy.block(0, 0, 2 * wl + 1, 1) = Eigen::VectorXd::Ones(2 * wl + 1);
-
-  Eigen::FFT<double> fft;
-  Eigen::VectorXcd tmp1 = fft.fwd(xx);
-  Eigen::VectorXcd tmp2 = fft.fwd(yy);
-  tmp2 = tmp2.conjugate();
-  tmp1 = tmp1.cwiseProduct(tmp2);
-  tmp2 = fft.inv(tmp1);
-  Eigen::VectorXd result = tmp2.real().block(wl, 0, n, 1);
-  result /= 2.0 * static_cast<double>(wl) + 1.0;
-  result.block(0, 0, wl, 1) = Eigen::VectorXd::Constant(wl, result(wl));
-  result.block(n - wl, 0, wl, 1) =
-    Eigen::VectorXd::Constant(wl, result(n - wl - 1));
+  Eigen::VectorXd result(x.size());
+  win(x, wl, result);
   return result;
 }
 
-//! helper routine for ace (In R, this would be win(x[ind], wl)[ranks])
-inline Eigen::VectorXd
-cef(const Eigen::VectorXd& x,
-    const Eigen::Matrix<size_t, Eigen::Dynamic, 1>& ind,
-    const Eigen::Matrix<size_t, Eigen::Dynamic, 1>& ranks,
-    size_t wl = 5)
+//! buffers for the alternating conditional expectation algorithm, such that
+//! its iterations don't allocate.
+struct AceWorkspace
 {
-  size_t n_ind = ind.size();
-  Eigen::VectorXd cey(n_ind);
-  for (size_t i = 0; i < n_ind; i++) {
-    cey(i) = x(ind(i));
+  explicit AceWorkspace(size_t n)
+    : phi(n, 2)
+    , sorted(n)
+    , smoothed(n)
+  {
   }
-  cey = win(cey, wl);
 
-  size_t n_ranks = ranks.size();
-  Eigen::VectorXd result(n_ranks);
-  for (size_t i = 0; i < n_ranks; i++) {
-    result(i) = cey(ranks(i));
+  Eigen::MatrixXd phi;
+  Eigen::VectorXd sorted;
+  Eigen::VectorXd smoothed;
+};
+
+//! helper routine for ace (In R, this would be win(x * w[ind], wl)[ranks]),
+//! followed by centering and standardization.
+//! @param x The values to smooth.
+//! @param w The weights.
+//! @param order The order of the variable to condition on.
+//! @param wl The half-width of the smoothing windows.
+//! @param ws Buffers.
+//! @param result A vector of the same size as `x` the result is written to.
+inline void
+cef(const Eigen::Ref<const Eigen::VectorXd>& x,
+    const Eigen::VectorXd& w,
+    const std::vector<size_t>& order,
+    size_t wl,
+    AceWorkspace& ws,
+    Eigen::Ref<Eigen::VectorXd> result)
+{
+  size_t n = x.size();
+  for (size_t i = 0; i < n; i++) {
+    ws.sorted(i) = x(order[i]) * w(order[i]);
+  }
+  win(ws.sorted, wl, ws.smoothed);
+
+  double n_dbl = static_cast<double>(n);
+  double m = ws.smoothed.sum() / n_dbl;
+  ws.smoothed.array() -= m;
+  ws.smoothed /= std::sqrt(ws.smoothed.cwiseAbs2().sum() / (n_dbl - 1));
+  for (size_t i = 0; i < n; i++) {
+    result(order[i]) = ws.smoothed(i);
   }
-  return result;
 }
 
-//! alternating conditional expectation algorithm
+//! alternating conditional expectation algorithm for two variables given by
+//! their orders (see `tools_stl::get_order()`); the result only depends on
+//! the data through the orders, so they can be shared among several pairs.
+//!
+//! @details The inner loop of the original algorithm re-computes the same
+//! conditional expectation as long as the first transformation is unchanged,
+//! so a single pass is done per outer iteration. When the outer iterations
+//! converge geometrically, they are accelerated by Aitken extrapolation.
 inline Eigen::MatrixXd
-ace(const Eigen::MatrixXd& data,                        // data
-    const Eigen::VectorXd& weights = Eigen::VectorXd(), // weights
-    size_t wl = 0,                // window length for the smoother
-    size_t outer_iter_max = 100,  // max number of outer iterations
-    size_t inner_iter_max = 10,   // max number of inner iterations
-    double outer_abs_tol = 2e-15, // outer stopping criterion
-    double inner_abs_tol = 1e-4)  // inner stopping criterion
+ace(const std::vector<size_t>& order0,
+    const std::vector<size_t>& order1,
+    const Eigen::VectorXd& weights,
+    size_t wl,
+    size_t outer_iter_max,
+    size_t inner_iter_max,
+    double outer_abs_tol)
 {
   // sample size and memory allocation for the outer/inner loops
-  size_t n = data.rows();
-  Eigen::VectorXd tmp(n);
+  size_t n = order0.size();
+  AceWorkspace ws(n);
 
   size_t nw = weights.size();
   Eigen::VectorXd w(n);
@@ -354,20 +1159,12 @@ ace(const Eigen::MatrixXd& data,                        // data
     wl = static_cast<size_t>(std::ceil(n_dbl / 5));
   }
 
-  // assign order/ranks to ind/ranks
-  Eigen::Matrix<size_t, Eigen::Dynamic, 2> ind(n, 2);
-  Eigen::Matrix<size_t, Eigen::Dynamic, 2> ranks(n, 2);
-  for (size_t i = 0; i < 2; i++) {
-    std::vector<double> xvec(data.data() + n * i, data.data() + n * (i + 1));
-    auto order = tools_stl::get_order(xvec);
-    for (auto j : order) {
-      ind(j, i) = order[j];
-      ranks(order[j], i) = j;
-    }
+  // initialize output with the standardized ranks
+  Eigen::MatrixXd& phi = ws.phi;
+  for (size_t i = 0; i < n; i++) {
+    phi(order0[i], 0) = static_cast<double>(i);
+    phi(order1[i], 1) = static_cast<double>(i);
   }
-
-  // initialize output
-  Eigen::MatrixXd phi = ranks.cast<double>();
   phi.array() -= (n_dbl - 1.0) / 2.0 - 1.0;
   phi /= std::sqrt(n_dbl * (n_dbl - 1.0) / 12.0);
   if (nw > 0) {
@@ -379,47 +1176,37 @@ ace(const Eigen::MatrixXd& data,                        // data
   size_t outer_iter = 1;
   double outer_eps = 1.0;
   double outer_abs_err = 1.0;
+  Eigen::VectorXd step = Eigen::VectorXd::Zero(n);
+  Eigen::VectorXd last_step = Eigen::VectorXd::Zero(n);
 
   // outer loop (expectation of the first variable given the second)
   while (outer_iter <= outer_iter_max && outer_abs_err > outer_abs_tol) {
-    // initialize variables for the inner loop
-    size_t inner_iter = 1;
-    double inner_eps = 1.0;
-    double inner_abs_err = 1.0;
-
-    // inner loop (expectation of the second variable given the first)
-    while (inner_iter <= inner_iter_max && inner_abs_err > inner_abs_tol) {
-      // conditional expectation
-      phi.col(1) =
-        cef(phi.col(0).cwiseProduct(w), ind.col(1), ranks.col(1), wl);
-
-      // center and standardize
-      double m1 = phi.col(1).sum() / n_dbl;
-      phi.col(1).array() -= m1;
-      double s1 = std::sqrt(phi.col(1).cwiseAbs2().sum() / (n_dbl - 1));
-      phi.col(1) /= s1;
-
-      // compute error and increase step
-      inner_abs_err = inner_eps;
-      tmp = (phi.col(1) - phi.col(0));
-      inner_eps = tmp.cwiseAbs2().sum() / n_dbl;
-      inner_abs_err = std::fabs(inner_abs_err - inner_eps);
-      inner_iter = inner_iter + 1;
-    }
-
-    // conditional expectation
-    phi.col(0) = cef(phi.col(1).cwiseProduct(w), ind.col(0), ranks.col(0), wl);
-
-    // center and standardize
-    double m0 = phi.col(0).sum() / n_dbl;
-    phi.col(0).array() -= m0;
-    double s0 = std::sqrt(phi.col(0).cwiseAbs2().sum() / (n_dbl - 1));
-    phi.col(0) /= s0;
+    // expectation of the second variable given the first
+    if (inner_iter_max > 0) {
+      cef(phi.col(0), w, order1, wl, ws, phi.col(1));
+    }
+    last_step.swap(step);
+    step = -phi.col(0);
+    cef(phi.col(1), w, order0, wl, ws, phi.col(0));
+    step += phi.col(0);
+
+    // when the last steps point in the same direction, the iterations
+    // converge geometrically along it; every third iteration, jump to the
+    // limit (Aitken extrapolation)
+    double step_norm = step.norm();
+    double last_step_norm = last_step.norm();
+    double rate = step_norm / last_step_norm;
+    double cos = step.dot(last_step) / (step_norm * last_step_norm);
+    if ((outer_iter % 3 == 0) && (cos > 0.999) && (rate < 0.9)) {
+      phi.col(0) += rate / (1.0 - rate) * step;
+      double m0 = phi.col(0).sum() / n_dbl;
+      phi.col(0).array() -= m0;
+      phi.col(0) /= std::sqrt(phi.col(0).cwiseAbs2().sum() / (n_dbl - 1));
+    }
 
     // compute error and increase step
     outer_abs_err = outer_eps;
-    tmp = (phi.col(1) - phi.col(0));
-    outer_eps = tmp.cwiseAbs2().sum() / n_dbl;
+    outer_eps = (phi.col(1) - phi.col(0)).squaredNorm() / n_dbl;
     outer_abs_err = std::fabs(outer_abs_err - outer_eps);
     outer_iter = outer_iter + 1;
   }
@@ -428,166 +1215,749 @@ ace(const Eigen::MatrixXd& data,                        // data
   return phi;
 }
 
+//! alternating conditional expectation algorithm
+inline Eigen::MatrixXd
+ace(const Eigen::MatrixXd& data,                        // data
+    const Eigen::VectorXd& weights = Eigen::VectorXd(), // weights
+    size_t wl = 0,                // window length for the smoother
+    size_t outer_iter_max = 100,  // max number of outer iterations
+    size_t inner_iter_max = 10,   // max number of inner iterations
+    double outer_abs_tol = 2e-15) // outer stopping criterion
+{
+  size_t n = data.rows();
+  std::vector<double> x0(data.data(), data.data() + n);
+  std::vector<double> x1(data.data() + n, data.data() + 2 * n);
+  return ace(tools_stl::get_order(x0),
+             tools_stl::get_order(x1),
+             weights,
+             wl,
+             outer_iter_max,
+             inner_iter_max,
+             outer_abs_tol);
+}
+
 //! calculates the pairwise maximum correlation coefficient.
 inline double
 pairwise_mcor(const Eigen::MatrixXd& x, const Eigen::VectorXd& weights)
 {
-  Eigen::MatrixXd phi = ace(x, weights);
+  size_t n = x.rows();
+  return pairwise_mcor(
+    tools_stl::get_order(std::vector<double>(x.data(), x.data() + n)),
+    tools_stl::get_order(std::vector<double>(x.data() + n, x.data() + 2 * n)),
+    weights);
+}
+
+//! calculates the maximum correlation coefficient of two variables given by
+//! their orders (see `tools_stl::get_order()`), such that the orders can be
+//! shared among several pairs.
+inline double
+pairwise_mcor(const std::vector<size_t>& order0,
+              const std::vector<size_t>& order1,
+              const Eigen::VectorXd& weights)
+{
+  Eigen::MatrixXd phi = ace(order0, order1, weights, 0, 100, 10, 2e-15);
   return wdm::wdm(phi, "cor", weights)(0, 1);
 }
-//! @}
 
-//! @brief Simulates from the multivariate Generalized Halton Sequence.
-//!
-//! For more information on Generalized Halton Sequence, see
-//! Faure, H., Lemieux, C. (2009). Generalized Halton Sequences in 2008:
-//! A Comparative Study. ACM-TOMACS 19(4), Article 15.
-//!
-//! @param n Number of observations.
-//! @param d Dimension.
-//! @param seeds Seeds to scramble the quasi-random numbers; if empty
-//! (default),
-//!   the quasi-random number generator is seeded randomly.
+//! @brief Calculates the maximum correlation coefficients of all pairs of
+//! columns.
 //!
-//! @return An \f$ n \times d \f$ matrix of quasi-random
-//! \f$ \mathrm{U}[0, 1] \f$ variables.
+//! The columns are sorted only once and the pairs are processed
+//! concurrently; the entries are the same as those of `pairwise_mcor()`.
+//! @param x A matrix of observations without missing values.
+//! @param weights Vector of weights for the observations (can be empty).
+//! @param num_threads The number of threads to use.
+//! @return A symmetric \f$ d \times d \f$ matrix with ones on the diagonal.
 inline Eigen::MatrixXd
-ghalton(const size_t& n, const size_t& d, const std::vector<int>& seeds)
+mcor_matrix(const Eigen::MatrixXd& x,
+            const Eigen::VectorXd& weights,
+            size_t num_threads)
 {
+  size_t n = x.rows();
+  size_t d = x.cols();
+  std::vector<std::vector<size_t>> orders(d);
+  for (size_t j = 0; j < d; j++) {
+    orders[j] = tools_stl::get_order(
+      std::vector<double>(x.col(j).data(), x.col(j).data() + n));
+  }
 
-  Eigen::MatrixXd res(d, n);
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for (size_t i = 1; i < d; i++) {
+    for (size_t j = 0; j < i; j++) {
+      pairs.push_back(std::make_pair(i, j));
+    }
+  }
 
-  // Coefficients of the shift
-  Eigen::MatrixXi shcoeff(d, 32);
-  Eigen::VectorXi base = tools_ghalton::primes.block(0, 0, d, 1);
-  Eigen::MatrixXd u = Eigen::VectorXd::Zero(d, 1);
-  auto U = simulate_uniform(d, 32, false, seeds);
-  for (int k = 31; k >= 0; k--) {
-    shcoeff.col(k) =
-      (base.cast<double>()).cwiseProduct(U.block(0, k, d, 1)).cast<int>();
-    u = (u + shcoeff.col(k).cast<double>()).cwiseQuotient(base.cast<double>());
+  Eigen::MatrixXd mat = Eigen::MatrixXd::Identity(d, d);
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    for (size_t k = b.begin; k < b.begin + b.size; k++) {
+      size_t i = pairs[k].first;
+      size_t j = pairs[k].second;
+      mat(i, j) = pairwise_mcor(orders[i], orders[j], weights);
+      mat(j, i) = mat(i, j);
+    }
+  };
+  tools_thread::parallel_for(0, pairs.size(), do_batch, num_threads, 1);
+  return mat;
+}
+//! @}
+
+//! @brief Sorts values by merging and counts the number of swaps (pairs that
+//! are in the wrong order) on the way.
+//! @param x The values, sorted in place.
+//! @param buffer A workspace of the same size as `x`.
+inline uint64_t
+merge_sort_swaps(std::vector<double>& x, std::vector<double>& buffer)
+{
+  size_t n = x.size();
+  uint64_t swaps = 0;
+  for (size_t width = 1; width < n; width *= 2) {
+    for (size_t begin = 0; begin < n; begin += 2 * width) {
+      size_t mid = std::min(begin + width, n);
+      size_t end = std::min(begin + 2 * width, n);
+      size_t i = begin, j = mid, k = begin;
+      while ((i < mid) && (j < end)) {
+        if (x[j] < x[i]) {
+          swaps += mid - i;
+          buffer[k++] = x[j++];
+        } else {
+          buffer[k++] = x[i++];
+        }
+      }
+      std::copy(x.begin() + i, x.begin() + mid, buffer.begin() + k);
+      std::copy(x.begin() + j, x.begin() + end, buffer.begin() + k + mid - i);
+    }
+    x.swap(buffer);
+  }
+  return swaps;
+}
+
+//! @brief Counts the pairs of equal values in sorted data.
+//! @param x The values, sorted.
+inline uint64_t
+count_tied_pairs(const std::vector<double>& x)
+{
+  uint64_t pairs = 0;
+  size_t run = 1;
+  for (size_t i = 1; i <= x.size(); i++) {
+    if ((i < x.size()) && (x[i] == x[i - 1])) {
+      run++;
+    } else {
+      pairs += static_cast<uint64_t>(run) * (run - 1) / 2;
+      run = 1;
+    }
   }
-  res.block(0, 0, d, 1) = u;
+  return pairs;
+}
 
-  Eigen::VectorXi perm = tools_ghalton::permTN2.block(0, 0, d, 1);
-  Eigen::MatrixXi coeff(d, 32);
-  Eigen::VectorXi tmp(d);
-  auto mod = [](const int& u1, const int& u2) { return u1 % u2; };
-  for (size_t i = 1; i < n; i++) {
+//! @brief Sorts values by merging and sums the products of the weights of
+//! the pairs that are in the wrong order on the way.
+//! @param x The values and their weights, sorted in place by value.
+//! @param buffer A workspace of the same size as `x`.
+inline double
+merge_sort_swaps(std::vector<std::pair<double, double>>& x,
+                 std::vector<std::pair<double, double>>& buffer)
+{
+  size_t n = x.size();
+  double swaps = 0.0;
+  for (size_t width = 1; width < n; width *= 2) {
+    for (size_t begin = 0; begin < n; begin += 2 * width) {
+      size_t mid = std::min(begin + width, n);
+      size_t end = std::min(begin + 2 * width, n);
+      // weight of the values left in the first half
+      double left = 0.0;
+      for (size_t i = begin; i < mid; i++) {
+        left += x[i].second;
+      }
+      size_t i = begin, j = mid, k = begin;
+      while ((i < mid) && (j < end)) {
+        if (x[j].first < x[i].first) {
+          swaps += x[j].second * left;
+          buffer[k++] = x[j++];
+        } else {
+          left -= x[i].second;
+          buffer[k++] = x[i++];
+        }
+      }
+      std::copy(x.begin() + i, x.begin() + mid, buffer.begin() + k);
+      std::copy(x.begin() + j, x.begin() + end, buffer.begin() + k + mid - i);
+    }
+    x.swap(buffer);
+  }
+  return swaps;
+}
 
-    // Find i in the prime base
-    tmp = Eigen::VectorXi::Constant(d, static_cast<int>(i));
-    coeff = Eigen::MatrixXi::Zero(d, 32);
-    int k = 0;
-    while ((tmp.maxCoeff() > 0) && (k < 32)) {
-      coeff.col(k) = tmp.binaryExpr(base, mod);
-      tmp = tmp.cwiseQuotient(base);
-      k++;
+//! @brief Sums the products of the weights of the pairs of equal values in
+//! sorted data.
+//! @param x The values and their weights, sorted by value.
+inline double
+count_tied_pairs(const std::vector<std::pair<double, double>>& x)
+{
+  double pairs = 0.0, w = 0.0, w2 = 0.0;
+  for (size_t i = 0; i < x.size(); i++) {
+    if ((i > 0) && (x[i].first != x[i - 1].first)) {
+      pairs += (w * w - w2) / 2.0;
+      w = 0.0;
+      w2 = 0.0;
     }
+    w += x[i].second;
+    w2 += x[i].second * x[i].second;
+  }
+  return pairs + (w * w - w2) / 2.0;
+}
 
-    u = Eigen::VectorXd::Zero(d);
-    k = 31;
-    while (k >= 0) {
-      tmp = perm.cwiseProduct(coeff.col(k)) + shcoeff.col(k);
-      u = u + tmp.binaryExpr(base, mod).cast<double>();
-      u = u.cwiseQuotient(base.cast<double>());
-      k--;
+//! @brief Calculates Kendall's \f$ \tau_b \f$ with Knight's algorithm.
+//! @param xy The observations, sorted in place.
+//! @param y,buffer Workspaces.
+inline double
+ktau_knight(std::vector<std::pair<double, double>>& xy,
+            std::vector<double>& y,
+            std::vector<double>& buffer)
+{
+  std::sort(xy.begin(), xy.end());
+
+  // ties in the first variable and joint ties
+  uint64_t ties_x = 0, ties_xy = 0;
+  size_t run_x = 1, run_xy = 1;
+  for (size_t i = 1; i <= xy.size(); i++) {
+    bool tie_x = (i < xy.size()) && (xy[i].first == xy[i - 1].first);
+    if (tie_x && (xy[i].second == xy[i - 1].second)) {
+      run_xy++;
+    } else {
+      ties_xy += static_cast<uint64_t>(run_xy) * (run_xy - 1) / 2;
+      run_xy = 1;
+    }
+    if (tie_x) {
+      run_x++;
+    } else {
+      ties_x += static_cast<uint64_t>(run_x) * (run_x - 1) / 2;
+      run_x = 1;
     }
-    res.block(0, i, d, 1) = u;
   }
 
-  return res.transpose();
+  // discordant pairs are the swaps needed to sort the second variable
+  y.resize(xy.size());
+  buffer.resize(xy.size());
+  for (size_t i = 0; i < xy.size(); i++) {
+    y[i] = xy[i].second;
+  }
+  uint64_t swaps = merge_sort_swaps(y, buffer);
+  uint64_t ties_y = count_tied_pairs(y);
+
+  double n = static_cast<double>(xy.size());
+  double n0 = 0.5 * n * (n - 1.0);
+  double concordant_minus_discordant =
+    n0 - static_cast<double>(ties_x + ties_y - ties_xy) -
+    2.0 * static_cast<double>(swaps);
+  return concordant_minus_discordant /
+         std::sqrt((n0 - static_cast<double>(ties_x)) *
+                   (n0 - static_cast<double>(ties_y)));
 }
 
-//! @brief Simulates from the multivariate Sobol sequence.
+//! @brief Calculates the weighted Kendall's \f$ \tau_b \f$ with Knight's
+//! algorithm.
 //!
-//! For more information on the Sobol sequence, see S. Joe and F. Y. Kuo
-//! (2008), constructing Sobol  sequences with better two-dimensional
-//! projections, SIAM J. Sci. Comput. 30, 2635–2654.
+//! Each pair of observations counts with the product of their weights.
+//! @param xyw The observations and their weights, sorted in place.
+//! @param yw,buffer Workspaces.
+inline double
+ktau_knight(std::vector<std::array<double, 3>>& xyw,
+            std::vector<std::pair<double, double>>& yw,
+            std::vector<std::pair<double, double>>& buffer)
+{
+  std::sort(xyw.begin(), xyw.end());
+
+  // ties in the first variable and joint ties
+  double ties_x = 0.0, ties_xy = 0.0;
+  double w_x = 0.0, w2_x = 0.0, w_xy = 0.0, w2_xy = 0.0;
+  for (size_t i = 0; i <= xyw.size(); i++) {
+    bool tie_x =
+      (i > 0) && (i < xyw.size()) && (xyw[i][0] == xyw[i - 1][0]);
+    if (!(tie_x && (xyw[i][1] == xyw[i - 1][1]))) {
+      ties_xy += (w_xy * w_xy - w2_xy) / 2.0;
+      w_xy = 0.0;
+      w2_xy = 0.0;
+    }
+    if (!tie_x) {
+      ties_x += (w_x * w_x - w2_x) / 2.0;
+      w_x = 0.0;
+      w2_x = 0.0;
+    }
+    if (i < xyw.size()) {
+      double w = xyw[i][2];
+      w_x += w;
+      w2_x += w * w;
+      w_xy += w;
+      w2_xy += w * w;
+    }
+  }
+
+  // discordant pairs are the swaps needed to sort the second variable
+  yw.resize(xyw.size());
+  buffer.resize(xyw.size());
+  double w = 0.0, w2 = 0.0;
+  for (size_t i = 0; i < xyw.size(); i++) {
+    yw[i] = std::make_pair(xyw[i][1], xyw[i][2]);
+    w += xyw[i][2];
+    w2 += xyw[i][2] * xyw[i][2];
+  }
+  double swaps = merge_sort_swaps(yw, buffer);
+  double ties_y = count_tied_pairs(yw);
+
+  double n0 = (w * w - w2) / 2.0;
+  return (n0 - ties_x - ties_y + ties_xy - 2.0 * swaps) /
+         std::sqrt((n0 - ties_x) * (n0 - ties_y));
+}
+
+//! @brief Calculates Kendall's \f$ \tau_b \f$ for many pairs of variables.
 //!
-//! @param n Number of observations.
-//! @param d Dimension.
+//! The pairs are processed concurrently with Knight's algorithm; all pairs of
+//! a thread share the same sorting workspace. Rows with missing values are
+//! omitted pair by pair. With weights, each pair of observations counts with
+//! the product of their weights.
+//! @param x An \f$ n \times 2m \f$ matrix whose columns \f$ 2k \f$ and
+//!   \f$ 2k + 1 \f$ contain the \f$ k \f$-th pair.
+//! @param weights Vector of weights for each observation (can be empty).
+//! @param num_threads The number of threads to use.
+//! @return A vector of length \f$ m \f$ (NaN if a variable is constant).
+inline Eigen::VectorXd
+ktau_pairs(const Eigen::MatrixXd& x,
+           const Eigen::VectorXd& weights,
+           size_t num_threads)
+{
+  if (x.cols() % 2 != 0) {
+    throw std::runtime_error("x must have an even number of columns.");
+  }
+  size_t n = x.rows();
+  if ((weights.size() > 0) && (static_cast<size_t>(weights.size()) != n)) {
+    throw std::runtime_error("weights must have the same length as x.");
+  }
+  size_t m = x.cols() / 2;
+  Eigen::VectorXd tau(m);
+
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    std::vector<std::pair<double, double>> xy, yw, buffer_w;
+    std::vector<std::array<double, 3>> xyw;
+    std::vector<double> y, buffer;
+    for (size_t k = b.begin; k < b.begin + b.size; k++) {
+      xy.clear();
+      xyw.clear();
+      for (size_t i = 0; i < n; i++) {
+        double x1 = x(i, 2 * k), x2 = x(i, 2 * k + 1);
+        if (std::isnan(x1) || std::isnan(x2)) {
+          continue;
+        }
+        if (weights.size() > 0) {
+          xyw.push_back({ { x1, x2, weights(i) } });
+        } else {
+          xy.push_back(std::make_pair(x1, x2));
+        }
+      }
+      if (weights.size() > 0) {
+        tau(k) = ktau_knight(xyw, yw, buffer_w);
+      } else {
+        tau(k) = ktau_knight(xy, y, buffer);
+      }
+    }
+  };
+  size_t grain =
+    tools_batch::compute_min_batch_size(10.0 * static_cast<double>(n));
+  tools_thread::parallel_for(0, m, do_batch, num_threads, grain);
+  return tau;
+}
+
+//! @brief Creates a generalized Halton sequence.
+//!
+//! @param d Dimension (at most 360).
 //! @param seeds Seeds to scramble the quasi-random numbers; if empty
-//! (default),
-//!   the quasi-random number generator is seeded randomly.
+//!   (default), the quasi-random number generator is seeded randomly.
+inline GhaltonSequence::GhaltonSequence(size_t d,
+                                        const std::vector<int>& seeds)
+  : d_(d)
+{
+  if ((d < 1) || (d > ghalton_max_dim)) {
+    throw std::runtime_error("Generalized Halton sequences are only available "
+                             "for dimensions 1 to " +
+                             std::to_string(ghalton_max_dim) + ".");
+  }
+  Eigen::VectorXd base = tools_ghalton::primes.head(d).cast<double>();
+  auto U = simulate_uniform(d, 32, false, seeds);
+  shift_ = (base.asDiagonal() * U).cast<int>();
+}
+
+//! @brief Gets the dimension of the sequence.
+inline size_t
+GhaltonSequence::get_dim() const
+{
+  return d_;
+}
+
+//! @brief Generates consecutive points of the sequence.
+//!
+//! @details The i-th point is \f$ u_{j} = \sum_{k = 0}^{31} ((p_j a_{k} +
+//! s_{jk}) \bmod b_j) b_j^{-(k + 1)} \f$, where \f$ a_{k} \f$ are the digits
+//! of i in the prime base \f$ b_j \f$, \f$ p_j \f$ is a permutation factor,
+//! and \f$ s_{jk} \f$ are the digits of a random shift. Moving to the next
+//! index only changes the lowest digits, so the partial sums of the higher
+//! digits are kept.
+//! @param begin The index of the first point.
+//! @param out An \f$ n \times d \f$ matrix the points are written into.
+inline void
+GhaltonSequence::generate(size_t begin, Eigen::Ref<Eigen::MatrixXd> out) const
+{
+  if (static_cast<size_t>(out.cols()) != d_) {
+    throw std::runtime_error("out must have " + std::to_string(d_) +
+                             " columns.");
+  }
+  size_t n = static_cast<size_t>(out.rows());
+  int digits[32];
+  double partial_sums[33]; // partial_sums[k] covers the digits k, ..., 31
+  for (size_t j = 0; j < d_; j++) {
+    int base = tools_ghalton::primes(j);
+    int perm = tools_ghalton::permTN2(j);
+    double base_dbl = static_cast<double>(base);
+    auto update = [&](int k) {
+      int digit = (perm * digits[k] + shift_(j, k)) % base;
+      partial_sums[k] =
+        (partial_sums[k + 1] + static_cast<double>(digit)) / base_dbl;
+    };
+
+    // digits of begin in the prime base
+    size_t index = begin;
+    for (int k = 0; k < 32; k++) {
+      digits[k] = static_cast<int>(index % static_cast<size_t>(base));
+      index /= static_cast<size_t>(base);
+    }
+    partial_sums[32] = 0.0;
+    for (int k = 31; k >= 0; k--) {
+      update(k);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      out(i, j) = partial_sums[0];
+      // increment the index and update the digits that have changed
+      int k = 0;
+      while ((++digits[k] == base) && (k < 31)) {
+        digits[k++] = 0;
+      }
+      for (; k >= 0; k--) {
+        update(k);
+      }
+    }
+  }
+}
+
+//! @brief Generates consecutive points of the sequence.
 //!
+//! @param begin The index of the first point.
+//! @param n The number of points.
 //! @return An \f$ n \times d \f$ matrix of quasi-random
 //! \f$ \mathrm{U}[0, 1] \f$ variables.
 inline Eigen::MatrixXd
-sobol(const size_t& n, const size_t& d, const std::vector<int>& seeds)
+GhaltonSequence::generate(size_t begin, size_t n) const
 {
+  Eigen::MatrixXd out(n, d_);
+  this->generate(begin, out);
+  return out;
+}
 
-  // output matrix
-  Eigen::MatrixXd output = Eigen::MatrixXd::Zero(n, d);
-
-  // L = max number of bits needed
-  size_t L =
-    static_cast<size_t>(std::ceil(log(static_cast<double>(n)) / log(2.0)));
-
-  // Vector of scrambling factors
-  Eigen::MatrixXd scrambling = simulate_uniform(d, 1, false, seeds);
+//! @brief Creates a Sobol sequence.
+//!
+//! @param d Dimension (at most 21201).
+//! @param seeds Seeds to scramble the quasi-random numbers; if empty
+//!   (default), the quasi-random number generator is seeded randomly.
+//! @param scrambling The randomization of the sequence; either `"owen"`
+//!   (default) for nested uniform scrambling or `"shift"` for a random
+//!   digital shift.
+inline SobolSequence::SobolSequence(size_t d,
+                                    const std::vector<int>& seeds,
+                                    const std::string& scrambling)
+  : d_(d)
+  , scrambling_(scrambling)
+{
+  if ((d < 1) || (d > tools_sobol::max_dim)) {
+    throw std::runtime_error("Sobol sequences are only available for "
+                             "dimensions 1 to " +
+                             std::to_string(tools_sobol::max_dim) + ".");
+  }
+  if ((scrambling != "owen") && (scrambling != "shift")) {
+    throw std::runtime_error("scrambling must be 'owen' or 'shift'.");
+  }
 
-  // C(i) = index from the right of the first zero bit of i + 1
-  Eigen::Matrix<size_t, Eigen::Dynamic, 1> C(n);
-  C(0) = 1;
-  for (size_t i = 1; i < n; i++) {
-    C(i) = 1;
-    size_t value = i;
-    while (value & 1) {
-      value >>= 1;
-      C(i)++;
+  // direction numbers scaled by pow(2,64); all m's = 1 in the first dimension
+  auto directions = std::make_shared<std::vector<uint64_t>>(64 * d);
+  uint64_t* V = directions->data();
+  for (size_t i = 0; i < 64; i++) {
+    V[i] = uint64_t{ 1 } << (64 - (i + 1));
+  }
+  tools_sobol::DirectionNumberReader reader;
+  size_t a;
+  std::vector<size_t> m;
+  for (size_t j = 1; j < d; j++) {
+    reader.next(a, m);
+    size_t s = m.size();
+    V = &(*directions)[64 * j];
+    for (size_t i = 0; i < s; i++)
+      V[i] = static_cast<uint64_t>(m[i]) << (64 - (i + 1));
+    for (size_t i = s; i < 64; i++) {
+      V[i] = V[i - s] ^ (V[i - s] >> s);
+      for (size_t k = 0; k < s - 1; k++)
+        V[i] ^= (((a >> (s - 2 - k)) & 1) * V[i - k - 1]);
     }
   }
+  directions_ = directions;
 
-  // Compute the first dimension
+  this->draw_scrambling(seeds);
+}
 
-  // Compute direction numbers scaled by pow(2,32)
-  Eigen::Matrix<size_t, Eigen::Dynamic, 1> V(L);
-  for (size_t i = 0; i < L; i++) {
-    V(i) = static_cast<size_t>(std::pow(2, 32 - (i + 1))); // all m's = 1
-  }
+//! @brief Gets the dimension of the sequence.
+inline size_t
+SobolSequence::get_dim() const
+{
+  return d_;
+}
 
-  // Evalulate X scaled by pow(2,32)
-  Eigen::Matrix<size_t, Eigen::Dynamic, 1> X(n);
-  X(0) = static_cast<size_t>(scrambling(0) * std::pow(2.0, 32));
-  for (size_t i = 1; i < n; i++) {
-    X(i) = X(i - 1) ^ V(C(i - 1) - 1);
-  }
-  output.block(0, 0, n, 1) = X.cast<double>();
+//! @brief Gets the type of scrambling (`"owen"` or `"shift"`).
+inline std::string
+SobolSequence::get_scrambling() const
+{
+  return scrambling_;
+}
 
-  // Compute the remaining dimensions
-  for (size_t j = 0; j < d - 1; j++) {
+//! @brief Creates an independently scrambled replicate of the sequence.
+//!
+//! @details The replicate shares the direction numbers with the original, so
+//! creating it only draws new scrambling seeds. Estimates from several
+//! replicates are independent and can be used for randomized quasi-Monte
+//! Carlo error bars.
+//! @param seeds Seeds to scramble the quasi-random numbers; if empty
+//!   (default), the quasi-random number generator is seeded randomly.
+inline SobolSequence
+SobolSequence::rescramble(const std::vector<int>& seeds) const
+{
+  SobolSequence replicate(*this);
+  replicate.draw_scrambling(seeds);
+  return replicate;
+}
 
-    // Get parameters from static vectors
-    size_t a = tools_sobol::a_sobol[j];
-    size_t s = tools_sobol::s_sobol[j];
+//! draws a random 64-bit shift or hash seed for each dimension.
+inline void
+SobolSequence::draw_scrambling(const std::vector<int>& seeds)
+{
+  Eigen::MatrixXd u = simulate_uniform(d_, 2, false, seeds);
+  seeds_.resize(d_);
+  for (size_t j = 0; j < d_; j++) {
+    seeds_[j] = (static_cast<uint64_t>(u(j, 0) * std::pow(2.0, 32)) << 32) |
+                static_cast<uint64_t>(u(j, 1) * std::pow(2.0, 32));
+  }
+}
 
-    Eigen::Map<Eigen::Matrix<size_t, Eigen::Dynamic, 1>> m(
-      tools_sobol::minit_sobol[j], s);
+//! reverses the order of the bits of `x`.
+inline uint64_t
+reverse_bits(uint64_t x)
+{
+  x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+  x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+  x = ((x >> 8) & 0x00FF00FF00FF00FF) | ((x & 0x00FF00FF00FF00FF) << 8);
+  x = ((x >> 16) & 0x0000FFFF0000FFFF) | ((x & 0x0000FFFF0000FFFF) << 16);
+  return (x >> 32) | (x << 32);
+}
 
-    // Compute direction numbers scaled by pow(2,32)
-    for (size_t i = 0; i < std::min(L, s); i++)
-      V(i) = m(i) << (32 - (i + 1));
+//! scrambles the bits of `x` such that each bit is flipped by a random
+//! function of the more significant bits (nested uniform scrambling).
+//!
+//! @details This is the hash-based approximation of Owen scrambling by
+//! Laine and Karras (2011) and Burley (2020), extended to 64 bits: on the
+//! reversed bits, additions, multiplications by odd numbers, and
+//! `x ^= x * even` change each bit only depending on the less significant
+//! ones.
+inline uint64_t
+owen_scramble(uint64_t x, uint64_t seed)
+{
+  x = reverse_bits(x);
+  x ^= x * 0x9E3779B97F4A7C14;
+  x += seed;
+  x *= (seed >> 32) | 1;
+  x ^= x * 0xBF58476D1CE4E5B8;
+  x ^= x * 0x94D049BB133111EA;
+  return reverse_bits(x);
+}
 
-    if (L > s) {
-      for (size_t i = s; i < L; i++) {
-        V(i) = V(i - s) ^ (V(i - s) >> s);
-        for (size_t k = 0; k < s - 1; k++)
-          V(i) ^= (((a >> (s - 2 - k)) & 1) * V(i - k - 1));
+//! @brief Generates consecutive points of the sequence.
+//!
+//! @details Points are generated in Gray code order (Antonov and Saleev,
+//! 1979): point i is the XOR of the direction numbers selected by the bits
+//! of the Gray code of i, so the first point can be computed directly for
+//! any index and each following point takes a single XOR. Points have 64
+//! bits, so up to \f$ 2^{64} \f$ points can be generated; the scrambling is
+//! applied to each point afterwards.
+//! @param begin The index of the first point.
+//! @param out An \f$ n \times d \f$ matrix the points are written into.
+inline void
+SobolSequence::generate(size_t begin, Eigen::Ref<Eigen::MatrixXd> out) const
+{
+  if (static_cast<size_t>(out.cols()) != d_) {
+    throw std::runtime_error("out must have " + std::to_string(d_) +
+                             " columns.");
+  }
+  size_t n = static_cast<size_t>(out.rows());
+  bool owen = (scrambling_ == "owen");
+  uint64_t gray = begin ^ (begin >> 1);
+  for (size_t j = 0; j < d_; j++) {
+    const uint64_t* V = &(*directions_)[64 * j];
+    uint64_t seed = seeds_[j];
+    uint64_t x = 0;
+    for (size_t k = 0; k < 64; k++) {
+      if ((gray >> k) & 1) {
+        x ^= V[k];
+      }
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint64_t y = owen ? owen_scramble(x, seed) : (x ^ seed);
+      out(i, j) = tools_random::to_unit_interval(
+        static_cast<uint32_t>(y >> 32), static_cast<uint32_t>(y));
+      // the next point flips the direction of the lowest zero bit of i
+      size_t k = 0;
+      for (size_t index = begin + i; index & 1; index >>= 1) {
+        k++;
+      }
+      if (k < 64) {
+        x ^= V[k];
       }
     }
+  }
+}
+
+//! @brief Generates consecutive points of the sequence.
+//!
+//! @param begin The index of the first point.
+//! @param n The number of points.
+//! @return An \f$ n \times d \f$ matrix of quasi-random
+//! \f$ \mathrm{U}[0, 1] \f$ variables.
+inline Eigen::MatrixXd
+SobolSequence::generate(size_t begin, size_t n) const
+{
+  Eigen::MatrixXd out(n, d_);
+  this->generate(begin, out);
+  return out;
+}
+
+//! generates `n` points of a sequence, possibly in parallel.
+template<class Sequence>
+Eigen::MatrixXd
+generate_sequence(const Sequence& sequence, size_t n, size_t num_threads)
+{
+  Eigen::MatrixXd out(n, sequence.get_dim());
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    sequence.generate(b.begin, out.middleRows(b.begin, b.size));
+  };
+  // a coordinate costs about a tenth of a Gaussian density evaluation
+  size_t grain = tools_batch::compute_min_batch_size(
+    0.1 * static_cast<double>(sequence.get_dim()));
+  tools_thread::parallel_for(0, n, do_batch, num_threads, grain);
+  return out;
+}
+
+//! @brief Simulates from the multivariate Generalized Halton Sequence.
+//!
+//! For more information on Generalized Halton Sequence, see
+//! Faure, H., Lemieux, C. (2009). Generalized Halton Sequences in 2008:
+//! A Comparative Study. ACM-TOMACS 19(4), Article 15.
+//!
+//! @param n Number of observations.
+//! @param d Dimension (at most 360).
+//! @param seeds Seeds to scramble the quasi-random numbers; if empty
+//! (default),
+//!   the quasi-random number generator is seeded randomly.
+//! @param num_threads The number of threads to use; if greater than 1,
+//!   disjoint ranges of the sequence are generated concurrently (see
+//!   `GhaltonSequence`).
+//!
+//! @return An \f$ n \times d \f$ matrix of quasi-random
+//! \f$ \mathrm{U}[0, 1] \f$ variables.
+inline Eigen::MatrixXd
+ghalton(const size_t& n,
+        const size_t& d,
+        const std::vector<int>& seeds,
+        size_t num_threads)
+{
+  return generate_sequence(GhaltonSequence(d, seeds), n, num_threads);
+}
+
+//! @brief Simulates from the multivariate Sobol sequence.
+//!
+//! For more information on the Sobol sequence, see S. Joe and F. Y. Kuo
+//! (2008), constructing Sobol  sequences with better two-dimensional
+//! projections, SIAM J. Sci. Comput. 30, 2635–2654. The sequence is
+//! randomized by nested uniform (Owen) scrambling, see `SobolSequence`.
+//!
+//! @param n Number of observations.
+//! @param d Dimension (at most 21201).
+//! @param seeds Seeds to scramble the quasi-random numbers; if empty
+//! (default),
+//!   the quasi-random number generator is seeded randomly.
+//! @param num_threads The number of threads to use; if greater than 1,
+//!   disjoint ranges of the sequence are generated concurrently (see
+//!   `SobolSequence`).
+//!
+//! @return An \f$ n \times d \f$ matrix of quasi-random
+//! \f$ \mathrm{U}[0, 1] \f$ variables.
+inline Eigen::MatrixXd
+sobol(const size_t& n,
+      const size_t& d,
+      const std::vector<int>& seeds,
+      size_t num_threads)
+{
+  return generate_sequence(SobolSequence(d, seeds), n, num_threads);
+}
 
-    // Evalulate X
-    X(0) = static_cast<size_t>(scrambling(j + 1) * std::pow(2.0, 32));
-    for (size_t i = 1; i < n; i++)
-      X(i) = X(i - 1) ^ V(C(i - 1) - 1);
-    output.block(0, j + 1, n, 1) = X.cast<double>();
+//! A block of rows processed at once by the bivariate distribution functions;
+//! its size is fixed, so that temporaries stay in the cache and on the stack.
+typedef Eigen::Array<double, Eigen::Dynamic, 1, Eigen::ColMajor, 256, 1>
+  ArrayBlock;
+
+//! evaluates `kernel(h, k)` on blocks of the rows of an \f$ n \times 2 \f$
+//! matrix `z = (h, k)`; rows containing a NaN evaluate to NaN.
+template<class Kernel>
+Eigen::VectorXd
+blockwise_or_nan(const Eigen::MatrixXd& z, const Kernel& kernel)
+{
+  const Eigen::Index block_size = ArrayBlock::MaxRowsAtCompileTime;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  Eigen::Index n = z.rows();
+  Eigen::VectorXd out(n);
+  for (Eigen::Index begin = 0; begin < n; begin += block_size) {
+    Eigen::Index size = std::min(block_size, n - begin);
+    ArrayBlock h = z.col(0).segment(begin, size).array();
+    ArrayBlock k = z.col(1).segment(begin, size).array();
+    ArrayBlock p = kernel(h, k);
+    out.segment(begin, size) = (h.isNaN() || k.isNaN()).select(nan, p);
   }
+  return out;
+}
+
+//! the standard normal cdf of a block.
+inline ArrayBlock
+pnorm_block(const ArrayBlock& x)
+{
+  return (-x / 1.4142135623730951).erfc() / 2;
+}
 
-  // Scale output by pow(2,32)
-  output /= std::pow(2.0, 32);
+//! exp of a block. Arguments are clamped at -600, since Eigen's vectorized
+//! exp and products of its results are slow for subnormal numbers (this
+//! changes results by less than 1e-260).
+inline ArrayBlock
+exp_block(const ArrayBlock& x)
+{
+  return (x < -600.).select(-600., x).exp();
+}
 
-  return output;
+//! atan2 of two blocks.
+inline ArrayBlock
+atan2_block(const ArrayBlock& y, const ArrayBlock& x)
+{
+  return y.binaryExpr(x, [](double a, double b) { return std::atan2(a, b); });
 }
 
 //! @brief Computes bivariate t probabilities.
@@ -598,6 +1968,8 @@ sobol(const size_t& n, const size_t& d, const std::vector<int>& seeds)
 //! with tables for certain special cases,
 //! Biometrika 41, pp. 153-169. Translated from the Fortran routines of
 //! Alan Genz (www.math.wsu.edu/faculty/genz/software/fort77/mvtdstpack.f).
+//! The recursion is evaluated for blocks of rows at once; all branches are
+//! resolved by selecting between both outcomes.
 //!
 //! @param z An \f$ n \times 2 \f$ matrix of evaluation points.
 //! @param nu Number of degrees of freedom.
@@ -607,112 +1979,80 @@ sobol(const size_t& n, const size_t& d, const std::vector<int>& seeds)
 inline Eigen::VectorXd
 pbvt(const Eigen::MatrixXd& z, int nu, double rho)
 {
-  double snu = sqrt(static_cast<double>(nu));
+  const double pi = 3.14159265358979323844;
+  const double two_pi = 6.2831853071795862;
+  double dnu = static_cast<double>(nu);
+  double snu = sqrt(dnu);
   double ors = 1 - pow(rho, 2.0);
-
-  auto f = [snu, nu, ors, rho](double h, double k) {
-    double d1, d2, bvt, gmph, gmpk, xnkh, xnhk, btnckh, btnchk, btpdkh, btpdhk;
-    int hs, ks;
-
-    double hrk = h - rho * k;
-    double krh = k - rho * h;
-    if (std::fabs(hrk) + ors > 0.) {
-      /* Computing 2nd power */
-      d1 = hrk;
-      /* Computing 2nd power */
-      d2 = hrk;
-      /* Computing 2nd power */
-      double d3 = k;
-      xnhk = d1 * d1 / (d2 * d2 + ors * (nu + d3 * d3));
-      /* Computing 2nd power */
-      d1 = krh;
-      /* Computing 2nd power */
-      d2 = krh;
-      /* Computing 2nd power */
-      d3 = h;
-      xnkh = d1 * d1 / (d2 * d2 + ors * (nu + d3 * d3));
-    } else {
-      xnhk = 0.;
-      xnkh = 0.;
-    }
-    d1 = h - rho * k;
-    hs = static_cast<int>(d1 >= 0 ? 1 : -1); // d_sign(&c_b91, &d1);
-    d1 = k - rho * h;
-    ks = static_cast<int>(d1 >= 0 ? 1 : -1);
+  // the constant part of the probability for even nu
+  double bvt_even = atan2(sqrt(ors), -rho) / two_pi;
+
+  auto f = [=](const ArrayBlock& h, const ArrayBlock& k) -> ArrayBlock {
+    ArrayBlock hrk = h - rho * k;
+    ArrayBlock krh = k - rho * h;
+    ArrayBlock inv_h2nu = 1 / (h * h / dnu + 1);
+    ArrayBlock inv_k2nu = 1 / (k * k / dnu + 1);
+    auto has_xn = (hrk.abs() + ors > 0.);
+    ArrayBlock xnhk =
+      has_xn.select(hrk * hrk / (hrk * hrk + ors * (dnu + k * k)), 0.);
+    ArrayBlock xnkh =
+      has_xn.select(krh * krh / (krh * krh + ors * (dnu + h * h)), 0.);
+    ArrayBlock hs = (hrk >= 0).select(ArrayBlock::Ones(h.size()), -1.);
+    ArrayBlock ks = (krh >= 0).select(ArrayBlock::Ones(h.size()), -1.);
+
+    ArrayBlock bvt, gmph, gmpk, btnckh, btnchk, btpdkh, btpdhk;
     if (nu % 2 == 0) {
-      bvt = atan2(sqrt(ors), -rho) / 6.2831853071795862;
-      /* Computing 2nd power */
-      d1 = h;
-      gmph = h / sqrt((nu + d1 * d1) * 16);
-      /* Computing 2nd power */
-      d1 = k;
-      gmpk = k / sqrt((nu + d1 * d1) * 16);
-      btnckh = atan2(sqrt(xnkh), sqrt(1 - xnkh)) * 2 / 3.14159265358979323844;
-      btpdkh = sqrt(xnkh * (1 - xnkh)) * 2 / 3.14159265358979323844;
-      btnchk = atan2(sqrt(xnhk), sqrt(1 - xnhk)) * 2 / 3.14159265358979323844;
-      btpdhk = sqrt(xnhk * (1 - xnhk)) * 2 / 3.14159265358979323844;
+      bvt = ArrayBlock::Constant(h.size(), bvt_even);
+      gmph = h / ((dnu + h * h) * 16).sqrt();
+      gmpk = k / ((dnu + k * k) * 16).sqrt();
+      btnckh = atan2_block(xnkh.sqrt(), (1 - xnkh).sqrt()) * 2 / pi;
+      btpdkh = (xnkh * (1 - xnkh)).sqrt() * 2 / pi;
+      btnchk = atan2_block(xnhk.sqrt(), (1 - xnhk).sqrt()) * 2 / pi;
+      btpdhk = (xnhk * (1 - xnhk)).sqrt() * 2 / pi;
       size_t i1 = static_cast<size_t>(nu / 2);
       for (size_t j = 1; j <= i1; ++j) {
         double jj = static_cast<double>(j << 1);
         bvt += gmph * (ks * btnckh + 1);
         bvt += gmpk * (hs * btnchk + 1);
         btnckh += btpdkh;
-        btpdkh = jj * btpdkh * (1 - xnkh) / (jj + 1);
+        btpdkh *= jj / (jj + 1) * (1 - xnkh);
         btnchk += btpdhk;
-        btpdhk = jj * btpdhk * (1 - xnhk) / (jj + 1);
-        /* Computing 2nd power */
-        d1 = h;
-        gmph = gmph * (jj - 1) / (jj * (d1 * d1 / nu + 1));
-        /* Computing 2nd power */
-        d1 = k;
-        gmpk = gmpk * (jj - 1) / (jj * (d1 * d1 / nu + 1));
+        btpdhk *= jj / (jj + 1) * (1 - xnhk);
+        gmph *= (jj - 1) / jj * inv_h2nu;
+        gmpk *= (jj - 1) / jj * inv_k2nu;
       }
     } else {
-      /* Computing 2nd power */
-      d1 = h;
-      /* Computing 2nd power */
-      d2 = k;
-      double qhrk = sqrt(d1 * d1 + d2 * d2 - rho * 2 * h * k + nu * ors);
-      double hkrn = h * k + rho * nu;
-      double hkn = h * k - nu;
-      double hpk = h + k;
-      bvt =
-        atan2(-snu * (hkn * qhrk + hpk * hkrn), hkn * hkrn - nu * hpk * qhrk) /
-        6.2831853071795862;
-      if (bvt < -1e-15) {
-        bvt += 1;
-      }
-      /* Computing 2nd power */
-      d1 = h;
-      gmph = h / (snu * 6.2831853071795862 * (d1 * d1 / nu + 1));
-      /* Computing 2nd power */
-      d1 = k;
-      gmpk = k / (snu * 6.2831853071795862 * (d1 * d1 / nu + 1));
-      btnckh = sqrt(xnkh);
+      ArrayBlock qhrk = (h * h + k * k - rho * 2 * h * k + dnu * ors).sqrt();
+      ArrayBlock hkrn = h * k + rho * dnu;
+      ArrayBlock hkn = h * k - dnu;
+      ArrayBlock hpk = h + k;
+      bvt = atan2_block(-snu * (hkn * qhrk + hpk * hkrn),
+                        hkn * hkrn - dnu * hpk * qhrk) /
+            two_pi;
+      bvt = (bvt < -1e-15).select(bvt + 1, bvt);
+      gmph = h / (snu * two_pi) * inv_h2nu;
+      gmpk = k / (snu * two_pi) * inv_k2nu;
+      btnckh = xnkh.sqrt();
       btpdkh = btnckh;
-      btnchk = sqrt(xnhk);
+      btnchk = xnhk.sqrt();
       btpdhk = btnchk;
       size_t i1 = static_cast<size_t>((nu - 1) / 2);
       for (size_t j = 1; j <= i1; ++j) {
         double jj = static_cast<double>(j << 1);
         bvt += gmph * (ks * btnckh + 1);
         bvt += gmpk * (hs * btnchk + 1);
-        btpdkh = (jj - 1) * btpdkh * (1 - xnkh) / jj;
+        btpdkh *= (jj - 1) / jj * (1 - xnkh);
         btnckh += btpdkh;
-        btpdhk = (jj - 1) * btpdhk * (1 - xnhk) / jj;
+        btpdhk *= (jj - 1) / jj * (1 - xnhk);
         btnchk += btpdhk;
-        /* Computing 2nd power */
-        d1 = h;
-        gmph = jj * gmph / ((jj + 1) * (d1 * d1 / nu + 1));
-        /* Computing 2nd power */
-        d1 = k;
-        gmpk = jj * gmpk / ((jj + 1) * (d1 * d1 / nu + 1));
+        gmph *= jj / (jj + 1) * inv_h2nu;
+        gmpk *= jj / (jj + 1) * inv_k2nu;
       }
     }
     return bvt;
   };
 
-  return tools_eigen::binaryExpr_or_nan(z, f);
+  return blockwise_or_nan(z, f);
 }
 
 //! @brief Compute bivariate normal probabilities.
@@ -724,6 +2064,9 @@ pbvt(const Eigen::MatrixXd& z, int nu, double rho)
 //! with extensive modications for double precisions by
 //! Alan Genz and Yihong Ge. Translated from the Fortran routines of
 //! Alan Genz (www.math.wsu.edu/faculty/genz/software/fort77/mvtdstpack.f).
+//! The quadrature nodes only depend on `rho` and are computed once; the
+//! integrand is evaluated for blocks of rows at once and all branches are
+//! resolved by selecting between both outcomes.
 //!
 //! @param z An \f$ n \times 2 \f$ matrix of evaluation points.
 //! @param rho Correlation.
@@ -732,11 +2075,6 @@ pbvt(const Eigen::MatrixXd& z, int nu, double rho)
 inline Eigen::VectorXd
 pbvnorm(const Eigen::MatrixXd& z, double rho)
 {
-
-  // normal cdf
-  boost::math::normal dist;
-  auto phi = [&dist](double y) { return boost::math::cdf(dist, y); };
-
   // set-up required constants
   size_t lg;
   if (std::fabs(rho) < .3f) {
@@ -746,7 +2084,7 @@ pbvnorm(const Eigen::MatrixXd& z, double rho)
   } else {
     lg = 10;
   }
-  Eigen::VectorXd w(lg), x(lg);
+  Eigen::ArrayXd w(lg), x(lg);
   if (std::fabs(rho) < .3f) {
     w << 0.1713244923791705, 0.3607615730481384, 0.4679139345726904;
     x << -.9324695142031522, -.6612093864662647, -.238619186083197;
@@ -766,89 +2104,83 @@ pbvnorm(const Eigen::MatrixXd& z, double rho)
       -.07652652113349733;
   }
 
-  auto f = [lg, rho, x, w, phi](double h, double k) {
-    size_t i1;
-    double d1, d2, hk, bvn;
-    h = -h;
-    k = -k;
-    hk = h * k;
-    bvn = 0.0;
-    if (std::fabs(rho) < .925f) {
-      double hs = (h * h + k * k) / 2;
-      double asr = asin(rho);
-      i1 = lg;
-      for (size_t i = 0; i < i1; ++i) {
-        double sn = std::sin(asr * (x(i) + 1) / 2);
-        bvn += w(i) * std::exp((sn * hk - hs) / (1 - sn * sn));
-        sn = std::sin(asr * (-x(i) + 1) / 2);
-        bvn += w(i) * std::exp((sn * hk - hs) / (1 - sn * sn));
-      }
-      d1 = -h;
-      d2 = -k;
-      bvn = bvn * asr / 12.566370614359172 + phi(d1) * phi(d2);
-    } else {
-      if (rho < 0.) {
-        k = -k;
-        hk = -hk;
-      }
-      if (std::fabs(rho) < 1.) {
-        double as = (1 - rho) * (rho + 1);
-        double a = std::sqrt(as);
-        /* Computing 2nd power */
-        d1 = h - k;
-        double bs = d1 * d1;
-        double c = (4 - hk) / 8;
-        double d = (12 - hk) / 16;
-        bvn = a * std::exp(-(bs / as + hk) / 2) *
-              (1 - c * (bs - as) * (1 - d * bs / 5) / 3 + c * d * as * as / 5);
-        if (hk > -160.) {
-          double b = std::sqrt(bs);
-          d1 = -b / a;
-          bvn -= std::exp(-hk / 2) * std::sqrt(6.283185307179586) * phi(d1) *
-                 b * (1 - c * bs * (1 - d * bs / 5) / 3);
-        }
-        a /= 2;
-        i1 = lg;
-        for (size_t i = 0; i < i1; ++i) {
-          /* Computing 2nd power */
-          d1 = a * (x(i) + 1);
-          double xs = d1 * d1;
-          double rs = std::sqrt(1 - xs);
-          bvn += a * w(i) *
-                 (std::exp(-bs / (xs * 2) - hk / (rs + 1)) / rs -
-                  std::exp(-(bs / xs + hk) / 2) * (c * xs * (d * xs + 1) + 1));
-          /* Computing 2nd power */
-          d1 = -x(i) + 1;
-          xs = as * (d1 * d1) / 4;
-          rs = std::sqrt(1 - xs);
-          /* Computing 2nd power */
-          d1 = rs + 1;
-          bvn += a * w(i) * std::exp(-(bs / xs + hk) / 2) *
-                 (std::exp(-hk * xs / (d1 * d1 * 2)) / rs -
-                  (c * xs * (d * xs + 1) + 1));
-        }
-        bvn = -bvn / 6.283185307179586;
+  if (std::fabs(rho) < .925f) {
+    // nodes on both sides of the center of the interval
+    double asr = asin(rho);
+    Eigen::ArrayXd sn(2 * lg), one_m_sn2(2 * lg);
+    for (size_t i = 0; i < lg; ++i) {
+      sn(2 * i) = std::sin(asr * (x(i) + 1) / 2);
+      sn(2 * i + 1) = std::sin(asr * (-x(i) + 1) / 2);
+    }
+    one_m_sn2 = 1 - sn * sn;
+
+    auto f = [&](const ArrayBlock& h, const ArrayBlock& k) -> ArrayBlock {
+      ArrayBlock hk = h * k;
+      ArrayBlock hs = (h * h + k * k) / 2;
+      ArrayBlock bvn = ArrayBlock::Zero(h.size());
+      for (size_t i = 0; i < 2 * lg; ++i) {
+        bvn += w(i / 2) * exp_block((sn(i) * hk - hs) / one_m_sn2(i));
       }
-      if (rho > 0.) {
-        d1 = -std::max(h, k);
-        bvn += phi(d1);
-      } else {
-        bvn = -bvn;
-        if (k > h) {
-          if (h < 0.) {
-            bvn = bvn + phi(k) - phi(h);
-          } else {
-            d1 = -h;
-            d2 = -k;
-            bvn = bvn + phi(d1) - phi(d2);
-          }
-        }
+      return bvn * asr / 12.566370614359172 + pnorm_block(h) * pnorm_block(k);
+    };
+    return blockwise_or_nan(z, f);
+  }
+
+  // nodes of the two integrals for |rho| close to 1 and the reciprocals
+  // needed for them
+  double as = (1 - rho) * (rho + 1);
+  double a = std::sqrt(as);
+  Eigen::ArrayXd aw = a / 2 * w;
+  Eigen::ArrayXd xs1 = (a / 2 * (x + 1)).square();
+  Eigen::ArrayXd rs1 = (1 - xs1).sqrt();
+  Eigen::ArrayXd inv_xs1 = 1 / xs1, inv_rs1 = 1 / rs1, inv_rs1p = 1 / (rs1 + 1);
+  Eigen::ArrayXd xs2 = as * (-x + 1).square() / 4;
+  Eigen::ArrayXd rs2 = (1 - xs2).sqrt();
+  Eigen::ArrayXd inv_xs2 = 1 / xs2, inv_rs2 = 1 / rs2;
+  Eigen::ArrayXd ts2 = xs2 / ((rs2 + 1).square() * 2);
+
+  auto f = [&](const ArrayBlock& h_in, const ArrayBlock& k_in) -> ArrayBlock {
+    ArrayBlock h = -h_in;
+    ArrayBlock k = -k_in;
+    if (rho < 0.) {
+      k = k_in;
+    }
+    ArrayBlock hk = h * k;
+    ArrayBlock bvn = ArrayBlock::Zero(h.size());
+    if (std::fabs(rho) < 1.) {
+      ArrayBlock bs = (h - k).square();
+      ArrayBlock c = (4 - hk) / 8;
+      ArrayBlock d = (12 - hk) / 16;
+      bvn = a * exp_block(-(bs / as + hk) / 2) *
+            (1 - c * (bs - as) * (1 - d * bs / 5) / 3 + c * d * as * as / 5);
+      ArrayBlock b = bs.sqrt();
+      ArrayBlock tail = exp_block(-hk / 2) * std::sqrt(6.283185307179586) *
+                        pnorm_block(-b / a) * b *
+                        (1 - c * bs * (1 - d * bs / 5) / 3);
+      bvn = (hk > -160.).select(bvn - tail, bvn);
+      ArrayBlock bs_half = bs / 2, hk_half = hk / 2, q;
+      for (size_t i = 0; i < lg; ++i) {
+        q = bs_half * inv_xs1(i);
+        bvn += aw(i) * (exp_block(-q - hk * inv_rs1p(i)) * inv_rs1(i) -
+                        exp_block(-(q + hk_half)) *
+                          (c * xs1(i) * (d * xs1(i) + 1) + 1));
+        q = bs_half * inv_xs2(i);
+        bvn += aw(i) * exp_block(-(q + hk_half)) *
+               (exp_block(-hk * ts2(i)) * inv_rs2(i) -
+                (c * xs2(i) * (d * xs2(i) + 1) + 1));
       }
+      bvn = -bvn / 6.283185307179586;
     }
-    return bvn;
+    if (rho > 0.) {
+      return bvn + pnorm_block(-h.max(k));
+    }
+    bvn = -bvn;
+    return (k > h).select((h < 0.).select(bvn + pnorm_block(k) - pnorm_block(h),
+                                          bvn + pnorm_block(-h) -
+                                            pnorm_block(-k)),
+                          bvn);
   };
-
-  return tools_eigen::binaryExpr_or_nan(z, f);
+  return blockwise_or_nan(z, f);
 }
 }
 }
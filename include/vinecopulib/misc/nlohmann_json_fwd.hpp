@@ -0,0 +1,71 @@
+/*
+ __ _____ _____ _____
+ __|  |   __|     |   | |  JSON for Modern C++
+ |  |  |__   |  |  | | | |  version 3.9.1
+ |_____|_____|_____|_|___|  https://github.com/nlohmann/json
+
+ Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+ SPDX-License-Identifier: MIT
+ Copyright (c) 2013-2019 Niels Lohmann <http://nlohmann.me>.
+
+ Permission is hereby  granted, free of charge, to any  person obtaining a copy
+ of this software and associated  documentation files (the "Software"), to deal
+ in the Software  without restriction, including without  limitation the rights
+ to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+ copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+ IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+ FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+ AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+ LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+// Forward declarations of nlohmann/json_fwd.hpp (version 3.9.1). Shares the
+// include guard with the corresponding section of nlohmann_json.hpp.
+
+#ifndef INCLUDE_NLOHMANN_JSON_FWD_HPP_
+#define INCLUDE_NLOHMANN_JSON_FWD_HPP_
+
+#include <cstdint> // int64_t, uint64_t
+#include <map>     // map
+#include <memory>  // allocator
+#include <string>  // string
+#include <vector>  // vector
+
+namespace nlohmann {
+template<typename T = void, typename SFINAE = void>
+struct adl_serializer;
+
+template<template<typename U, typename V, typename... Args> class ObjectType =
+           std::map,
+         template<typename U, typename... Args> class ArrayType = std::vector,
+         class StringType = std::string,
+         class BooleanType = bool,
+         class NumberIntegerType = std::int64_t,
+         class NumberUnsignedType = std::uint64_t,
+         class NumberFloatType = double,
+         template<typename U> class AllocatorType = std::allocator,
+         template<typename T, typename SFINAE = void> class JSONSerializer =
+           adl_serializer,
+         class BinaryType = std::vector<std::uint8_t>>
+class basic_json;
+
+template<typename BasicJsonType>
+class json_pointer;
+
+using json = basic_json<>;
+
+template<class Key, class T, class IgnoredLess, class Allocator>
+struct ordered_map;
+
+using ordered_json = basic_json<nlohmann::ordered_map>;
+} // namespace nlohmann
+
+#endif // INCLUDE_NLOHMANN_JSON_FWD_HPP_
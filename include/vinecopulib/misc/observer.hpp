@@ -0,0 +1,144 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vinecopulib/bicop/family.hpp>
+
+namespace vinecopulib {
+
+//! @brief A fit of a single bivariate copula family (see
+//! `Observer::on_fit()`).
+struct FitEvent
+{
+  BicopFamily family;     //!< The fitted family.
+  int rotation;           //!< The rotation of the family.
+  std::string method;     //!< The estimation method.
+  size_t nobs;            //!< The number of observations.
+  double loglik;          //!< The log-likelihood of the fitted model.
+  size_t objective_calls; //!< The number of objective function evaluations.
+  double seconds;         //!< The wall time of the fit.
+};
+
+//! @brief A finished pair-copula of a vine (see `Observer::on_edge()`).
+struct EdgeEvent
+{
+  size_t tree;            //!< The tree level (starting at 0).
+  size_t edge;            //!< The edge index within the tree.
+  BicopFamily family;     //!< The selected family.
+  int rotation;           //!< The rotation of the selected family.
+  size_t objective_calls; //!< The objective function evaluations of all fits.
+  double seconds;         //!< The summed wall time of all fits.
+};
+
+//! @brief A batch of an evaluation function (see `Observer::on_batch()`).
+struct BatchEvent
+{
+  std::string function; //!< The name of the function, e.g., `"pdf"`.
+  size_t begin;         //!< The index of the first observation.
+  size_t size;          //!< The number of observations.
+  double seconds;       //!< The wall time of the batch.
+};
+
+//! @brief An interface for observing the progress of fits and evaluations.
+//!
+//! @details Derived classes override the callbacks for the events they are
+//! interested in; all callbacks do nothing by default. Fits report to the
+//! observer set by `FitControlsBicop::set_observer()`, evaluation functions
+//! to the one set by an `ObserverScope`. Without an observer, no events are
+//! created and no time is measured.
+//!
+//! Callbacks may be called from several threads at once and must be
+//! thread-safe. Exceptions thrown by a callback abort the computation.
+class Observer
+{
+public:
+  virtual ~Observer() = default;
+
+  //! @brief Called when the selection of a tree starts.
+  //! @param tree The tree level (starting at 0).
+  virtual void on_tree_start(size_t /* tree */) {}
+
+  //! @brief Called when the criteria of all allowed edges of a tree have
+  //! been computed.
+  //! @param tree The tree level.
+  //! @param num_edges The number of allowed edges.
+  //! @param seconds The wall time.
+  virtual void on_edges_scored(size_t /* tree */,
+                               size_t /* num_edges */,
+                               double /* seconds */)
+  {}
+
+  //! @brief Called when the maximum spanning tree has been found.
+  //! @param tree The tree level.
+  //! @param num_edges The number of edges of the spanning tree.
+  //! @param seconds The wall time.
+  virtual void on_mst(size_t /* tree */,
+                      size_t /* num_edges */,
+                      double /* seconds */)
+  {}
+
+  //! @brief Called after each fit of a bivariate copula family.
+  virtual void on_fit(const FitEvent& /* event */) {}
+
+  //! @brief Called when a pair-copula of a vine has been fitted or selected.
+  virtual void on_edge(const EdgeEvent& /* event */) {}
+
+  //! @brief Called when the selection of a tree is finished.
+  //! @param tree The tree level.
+  //! @param seconds The wall time since the tree was started.
+  virtual void on_tree_finish(size_t /* tree */, double /* seconds */) {}
+
+  //! @brief Called after each batch of `Vinecop::pdf()`, `rosenblatt()`, and
+  //! `inverse_rosenblatt()`.
+  virtual void on_batch(const BatchEvent& /* event */) {}
+};
+
+//! @brief Sets the observer of evaluation functions called from the calling
+//! thread while in scope.
+//!
+//! @code
+//! auto observer = std::make_shared<MyObserver>();
+//! {
+//!   ObserverScope scope(observer);
+//!   auto p = vc.pdf(u, 4);
+//! }
+//! @endcode
+class ObserverScope
+{
+public:
+  explicit ObserverScope(std::shared_ptr<Observer> observer);
+  ~ObserverScope();
+
+  ObserverScope(const ObserverScope&) = delete;
+  ObserverScope& operator=(const ObserverScope&) = delete;
+
+  static std::shared_ptr<Observer> get_current();
+
+private:
+  static std::shared_ptr<Observer>& current();
+
+  std::shared_ptr<Observer> previous_;
+};
+
+//! @brief Measures wall time, but only if there is an observer to report to.
+class ObserverTimer
+{
+public:
+  explicit ObserverTimer(const Observer* observer);
+
+  double get_seconds() const;
+
+private:
+  bool active_;
+  std::chrono::steady_clock::time_point start_;
+};
+}
+
+#include <vinecopulib/misc/implementation/observer.ipp>
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -19,6 +20,11 @@ struct Batch
   size_t size;
 };
 
+//! The minimal cost of a batch, in units of the cost of evaluating the
+//! density of a Gaussian pair-copula at a single point. Smaller batches don't
+//! pay off the overhead of scheduling them on another thread.
+const double min_batch_cost = 1000.0;
+
 inline size_t
 compute_num_batches(size_t num_tasks, size_t num_threads)
 {
@@ -30,21 +36,52 @@ compute_num_batches(size_t num_tasks, size_t num_threads)
   return std::min(num_tasks, num_batches);
 }
 
+//! computes the minimal batch size for tasks of a given cost.
+//! @param task_cost The cost of a single task, in the units of
+//!   `min_batch_cost`.
+inline size_t
+compute_min_batch_size(double task_cost)
+{
+  if (!(task_cost > 0.0))
+    return 1;
+  return static_cast<size_t>(std::ceil(min_batch_cost / task_cost));
+}
+
+//! splits `num_tasks` tasks into contiguous batches.
+//!
+//! @details Batches are created by guided self-scheduling: each batch takes
+//! a share of the remaining tasks, but no more than the batch size implied by
+//! `compute_num_batches()`. Batches get smaller towards the end of the range,
+//! so threads that finish early can pick up the remaining work and uneven
+//! task costs are balanced. If there are fewer than `2 * min_batch_size`
+//! tasks, a single batch is returned.
+//! @param num_tasks The number of tasks.
+//! @param num_threads The number of threads the batches are shared among.
+//! @param min_batch_size The minimal number of tasks per batch (unless there
+//!   are fewer tasks in total).
 inline std::vector<Batch>
-create_batches(size_t num_tasks, size_t num_threads)
+create_batches(size_t num_tasks,
+               size_t num_threads,
+               size_t min_batch_size = 1)
 {
   if (num_tasks == 0)
     return { Batch{ 0, 0 } };
   num_threads = std::max(static_cast<size_t>(1), num_threads);
+  min_batch_size = std::max(static_cast<size_t>(1), min_batch_size);
 
   size_t num_batches = compute_num_batches(num_tasks, num_threads);
-  std::vector<Batch> batches(num_batches);
+  size_t max_batch_size = (num_tasks + num_batches - 1) / num_batches;
+  max_batch_size = std::max(max_batch_size, min_batch_size);
 
-  size_t min_size = num_tasks / num_batches;
-  ptrdiff_t rem_size = num_tasks % num_batches;
-  for (size_t i = 0, k = 0; i < num_tasks; k++) {
-    batches[k] = Batch{ i, min_size + (rem_size-- > 0) };
-    i += batches[k].size;
+  std::vector<Batch> batches;
+  for (size_t begin = 0; begin < num_tasks;) {
+    size_t num_left = num_tasks - begin;
+    size_t size = num_left / (2 * num_threads);
+    size = std::max(min_batch_size, std::min(size, max_batch_size));
+    if (num_left < size + min_batch_size)
+      size = num_left; // don't leave a batch that is too small
+    batches.push_back(Batch{ begin, size });
+    begin += size;
   }
 
   return batches;
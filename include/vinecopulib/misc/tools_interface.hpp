@@ -21,11 +21,30 @@ static RcppThread::RPrinter Rcout = RcppThread::RPrinter();
 #endif
 
 // parallel backend
+#include <vinecopulib/misc/cancellation.hpp>
 #include <vinecopulib/misc/tools_batch.hpp>
 #ifdef INTERFACED_FROM_R
 namespace vinecopulib {
 namespace tools_thread {
 typedef RcppThread::ThreadPool ThreadPool;
+typedef RcppThread::ThreadPool TaskGroup;
+
+template<class F>
+void
+parallel_for(size_t begin,
+             size_t end,
+             F&& f,
+             size_t num_threads,
+             size_t grain = 1)
+{
+  auto batches = tools_batch::create_batches(end - begin, num_threads, grain);
+  for (auto& batch : batches) {
+    batch.begin += begin;
+  }
+  ThreadPool pool((num_threads == 1) ? 0 : num_threads);
+  pool.map(f, batches);
+  pool.join();
+}
 }
 }
 #else
@@ -43,6 +62,10 @@ check_user_interrupt(bool do_check = true)
 #ifdef INTERFACED_FROM_R
     RcppThread::checkUserInterrupt();
 #endif
+    auto token = CancellationScope::get_current();
+    if (token && token->is_cancelled()) {
+      throw CancelledException();
+    }
   }
 }
 }
@@ -0,0 +1,216 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+#pragma once
+
+// Counts heap allocations of tests and benchmarks. If VINECOPULIB_MEMORY_STATS
+// is defined (CMake option of the same name), this header replaces malloc and
+// friends, which are also used by operator new and Eigen. It must then be
+// included in exactly one translation unit of the executable. Without the
+// macro, or on platforms other than glibc, all counts are zero.
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(VINECOPULIB_MEMORY_STATS) && defined(__GLIBC__)
+#define VINECOPULIB_COUNT_ALLOCATIONS
+#include <malloc.h>
+#endif
+
+namespace vinecopulib {
+
+namespace tools_memory {
+
+//! @brief Heap statistics since the last call to `reset_stats()`.
+struct MemoryStats
+{
+  size_t allocations; //!< Number of allocations.
+  size_t bytes;       //!< Total number of allocated bytes.
+  size_t peak_bytes;  //!< Peak of live bytes on top of those at the reset.
+};
+
+//! @brief Whether allocations are counted.
+inline bool
+is_counting()
+{
+#ifdef VINECOPULIB_COUNT_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace detail {
+
+struct Counters
+{
+  std::atomic<size_t> allocations;
+  std::atomic<size_t> bytes;
+  std::atomic<size_t> live;
+  std::atomic<size_t> peak;
+  std::atomic<size_t> baseline;
+};
+
+// constant-initialized, so it can be used before static initialization
+inline Counters&
+get_counters()
+{
+  static Counters counters{ { 0 }, { 0 }, { 0 }, { 0 }, { 0 } };
+  return counters;
+}
+
+inline void
+record_allocation(size_t bytes)
+{
+  auto& c = get_counters();
+  c.allocations.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  size_t live = c.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  size_t peak = c.peak.load(std::memory_order_relaxed);
+  while ((live > peak) && !c.peak.compare_exchange_weak(peak, live)) {
+  }
+}
+
+inline void
+record_deallocation(size_t bytes)
+{
+  get_counters().live.fetch_sub(bytes, std::memory_order_relaxed);
+}
+}
+
+//! @brief Gets the heap statistics since the last reset.
+inline MemoryStats
+get_stats()
+{
+  auto& c = detail::get_counters();
+  size_t peak = c.peak.load();
+  size_t baseline = c.baseline.load();
+  return { c.allocations.load(),
+           c.bytes.load(),
+           (peak > baseline) ? peak - baseline : 0 };
+}
+
+//! @brief Resets the heap statistics.
+inline void
+reset_stats()
+{
+  auto& c = detail::get_counters();
+  c.allocations = 0;
+  c.bytes = 0;
+  c.baseline = c.live.load();
+  c.peak = c.baseline.load();
+}
+
+//! @brief Gets the peak resident set size of the process in bytes (0 if
+//! unknown).
+inline size_t
+get_peak_rss()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoul(line.substr(6)) * 1024;
+    }
+  }
+  return 0;
+}
+
+//! @brief Resets the peak resident set size to the current one (Linux only).
+//! @return Whether the reset was successful.
+inline bool
+reset_peak_rss()
+{
+  std::FILE* file = std::fopen("/proc/self/clear_refs", "w");
+  if (!file) {
+    return false;
+  }
+  bool success = (std::fputs("5", file) >= 0);
+  return (std::fclose(file) == 0) && success;
+}
+}
+}
+
+#ifdef VINECOPULIB_COUNT_ALLOCATIONS
+// replacements of the glibc allocation functions
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t num, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(size_t size) noexcept
+  {
+    void* ptr = __libc_malloc(size);
+    if (ptr) {
+      vinecopulib::tools_memory::detail::record_allocation(
+        malloc_usable_size(ptr));
+    }
+    return ptr;
+  }
+
+  void* calloc(size_t num, size_t size) noexcept
+  {
+    void* ptr = __libc_calloc(num, size);
+    if (ptr) {
+      vinecopulib::tools_memory::detail::record_allocation(
+        malloc_usable_size(ptr));
+    }
+    return ptr;
+  }
+
+  void* realloc(void* ptr, size_t size) noexcept
+  {
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void* new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr || (size == 0)) {
+      vinecopulib::tools_memory::detail::record_deallocation(old_size);
+    }
+    if (new_ptr) {
+      vinecopulib::tools_memory::detail::record_allocation(
+        malloc_usable_size(new_ptr));
+    }
+    return new_ptr;
+  }
+
+  void* memalign(size_t alignment, size_t size) noexcept
+  {
+    void* ptr = __libc_memalign(alignment, size);
+    if (ptr) {
+      vinecopulib::tools_memory::detail::record_allocation(
+        malloc_usable_size(ptr));
+    }
+    return ptr;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) noexcept
+  {
+    return memalign(alignment, size);
+  }
+
+  int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+  {
+    *ptr = memalign(alignment, size);
+    return (*ptr || (size == 0)) ? 0 : ENOMEM;
+  }
+
+  void free(void* ptr) noexcept
+  {
+    if (ptr) {
+      vinecopulib::tools_memory::detail::record_deallocation(
+        malloc_usable_size(ptr));
+    }
+    __libc_free(ptr);
+  }
+}
+#endif
@@ -0,0 +1,71 @@
+// Copyright © 2016-2025 Thomas Nagler and Thibault Vatter
+//
+// This file is part of the vinecopulib library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory of
+// vinecopulib or https://vinecopulib.github.io/vinecopulib/.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace vinecopulib {
+
+namespace tools_random {
+
+//! @brief The Philox4x32-10 counter-based random number generator.
+//!
+//! @details Maps a 128-bit counter to 128 random bits under a 64-bit key
+//! (Salmon et al., 2011, Parallel random numbers: as easy as 1, 2, 3,
+//! SC '11). Since every counter can be evaluated independently, each thread
+//! can generate any part of a random stream without coordination.
+class Philox4x32
+{
+public:
+  typedef std::array<uint32_t, 4> Counter;
+  typedef std::array<uint32_t, 2> Key;
+
+  explicit Philox4x32(const Key& key);
+
+  Counter operator()(Counter counter) const;
+
+private:
+  Key key_;
+};
+
+//! @brief Creates the generator.
+//! @param key The key selecting the random stream.
+inline Philox4x32::Philox4x32(const Key& key)
+  : key_(key)
+{
+}
+
+//! @brief Computes the random bits for a counter.
+inline Philox4x32::Counter
+Philox4x32::operator()(Counter counter) const
+{
+  Key key = key_;
+  for (int round = 0; round < 10; ++round) {
+    uint64_t prod0 = uint64_t{ 0xD2511F53 } * counter[0];
+    uint64_t prod1 = uint64_t{ 0xCD9E8D57 } * counter[2];
+    counter = { static_cast<uint32_t>(prod1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(prod1),
+                static_cast<uint32_t>(prod0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(prod0) };
+    key[0] += 0x9E3779B9;
+    key[1] += 0xBB67AE85;
+  }
+  return counter;
+}
+
+//! @brief Converts 64 random bits to a double in the open interval (0, 1).
+//! @param hi The upper 32 bits.
+//! @param lo The lower 32 bits.
+inline double
+to_unit_interval(uint32_t hi, uint32_t lo)
+{
+  uint64_t bits = ((static_cast<uint64_t>(hi) << 32) | lo) >> 11;
+  return (static_cast<double>(bits) + 0.5) / 9007199254740992.0; // 2^53
+}
+}
+}
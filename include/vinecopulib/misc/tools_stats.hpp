@@ -6,98 +6,42 @@
 
 #pragma once
 
-#include <boost/math/distributions.hpp>
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <set>
-#include <unsupported/Eigen/SpecialFunctions>
-#include <vinecopulib/misc/tools_eigen.hpp>
+#include <string>
+#include <vector>
 
 namespace vinecopulib {
 
 namespace tools_stats {
 
-//! @brief Density function of the Standard normal distribution.
-//!
-//! @param x Evaluation points.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated densities.
-inline Eigen::MatrixXd
-dnorm(const Eigen::MatrixXd& x)
-{
-  static constexpr double inv_sqrt_2pi = 0.39894228040143270286;
-  return inv_sqrt_2pi * (-0.5 * x.array().square()).exp();
-}
+Eigen::MatrixXd
+dnorm(const Eigen::MatrixXd& x);
 
-//! @brief Distribution function of the Standard normal distribution.
-//!
-//! @param x Evaluation points.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated probabilities.
-inline Eigen::MatrixXd
-pnorm(const Eigen::MatrixXd& x)
-{
-  static const double sqrt2 = std::sqrt(2.0);
-  return 0.5 * (1.0 + (x.array() / sqrt2).erf());
-}
+Eigen::MatrixXd
+pnorm(const Eigen::MatrixXd& x);
 
-//! @brief Quantile function of the Standard normal distribution.
-//!
-//! @param x Evaluation points.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated quantiles.
-inline Eigen::MatrixXd
-qnorm(const Eigen::MatrixXd& x)
-{
-  return x.array().ndtri();
-}
+Eigen::MatrixXd
+qnorm(const Eigen::MatrixXd& x);
 
-//! @brief Density function of the Student t distribution.
-//!
-//! @param x Evaluation points.
-//! @param nu Degrees of freedom parameter.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated densities.
-inline Eigen::MatrixXd
-dt(const Eigen::MatrixXd& x, double nu)
-{
-  boost::math::students_t dist(nu);
-  auto f = [&dist](double y) { return boost::math::pdf(dist, y); };
-  return tools_eigen::unaryExpr_or_nan(x, f);
-}
+Eigen::MatrixXd
+dt(const Eigen::MatrixXd& x, double nu);
 
-//! @brief Distribution function of the Student t distribution.
-//!
-//! @param x Evaluation points.
-//! @param nu Degrees of freedom parameter.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated probabilities.
-inline Eigen::MatrixXd
-pt(const Eigen::MatrixXd& x, double nu)
-{
-  boost::math::students_t dist(nu);
-  auto f = [&dist](double y) { return boost::math::cdf(dist, y); };
-  return tools_eigen::unaryExpr_or_nan(x, f);
-}
+Eigen::MatrixXd
+pt(const Eigen::MatrixXd& x, double nu);
 
-//! @brief Quantile function of the Student t distribution.
-//!
-//! @param x Evaluation points.
-//! @param nu Degrees of freedom parameter.
-//!
-//! @return An \f$ n \times d \f$ matrix of evaluated quantiles.
-inline Eigen::MatrixXd
-qt(const Eigen::MatrixXd& x, double nu)
-{
-  boost::math::students_t dist(nu);
-  auto f = [&dist](double y) { return boost::math::quantile(dist, y); };
-  return tools_eigen::unaryExpr_or_nan(x, f);
-}
+Eigen::MatrixXd
+qt(const Eigen::MatrixXd& x, double nu);
 
 Eigen::MatrixXd
 simulate_uniform(const size_t& n,
                  const size_t& d,
                  bool qrng = false,
-                 std::vector<int> seeds = std::vector<int>());
+                 std::vector<int> seeds = std::vector<int>(),
+                 size_t num_threads = 1);
 
 Eigen::MatrixXd
 simulate_normal(const size_t& n,
@@ -115,9 +59,75 @@ Eigen::MatrixXd
 to_pseudo_obs(Eigen::MatrixXd x,
               const std::string& ties_method = "average",
               const Eigen::VectorXd& weights = Eigen::VectorXd(),
-              std::vector<int> seeds = std::vector<int>());
+              std::vector<int> seeds = std::vector<int>(),
+              size_t num_threads = 1);
+
+//! @brief A multiset of numbers that counts the elements smaller than or
+//! equal to a value in logarithmic time (a treap with subtree sizes).
+class OrderStatisticTree
+{
+public:
+  OrderStatisticTree();
+
+  void insert(double value);
+  void erase(double value);
+  void clear();
+
+  size_t size() const;
+  size_t count_less(double value) const;
+  size_t count(double value) const;
+
+private:
+  struct Node
+  {
+    double value;
+    size_t count;    // multiplicity of the value
+    size_t size;     // number of elements in the subtree
+    uint32_t weight; // random heap priority
+    ptrdiff_t left;
+    ptrdiff_t right;
+  };
+
+  size_t get_size(ptrdiff_t t) const;
+  void update_size(ptrdiff_t t);
+  ptrdiff_t rotate_left(ptrdiff_t t);
+  ptrdiff_t rotate_right(ptrdiff_t t);
+  ptrdiff_t insert(ptrdiff_t t, double value);
+  ptrdiff_t erase(ptrdiff_t t, double value);
+
+  std::vector<Node> nodes_;
+  std::vector<ptrdiff_t> free_nodes_;
+  ptrdiff_t root_;
+  uint32_t state_; // state of the generator of the priorities
+};
+
+//! @brief Pseudo-observations of a data set to which observations are added
+//! and from which they are removed over time (see `to_pseudo_obs()`).
+class OnlinePseudoObs
+{
+public:
+  explicit OnlinePseudoObs(size_t d,
+                           const std::string& ties_method = "average");
 
-// Covers the unit hypercube with boxes and assigns each sample to a box.
+  void insert(const Eigen::MatrixXd& x);
+  void erase(const Eigen::MatrixXd& x);
+  void clear();
+
+  size_t get_dim() const;
+  size_t get_n() const;
+  Eigen::MatrixXd get_pseudo_obs(const Eigen::MatrixXd& x) const;
+
+private:
+  void check_dim(const Eigen::MatrixXd& x) const;
+
+  std::string ties_method_;
+  size_t n_;
+  std::vector<OrderStatisticTree> trees_;
+};
+
+// Covers the unit square with K x K cells and assigns each sample to a cell.
+// The samples of a cell form a linked list, so that moving a sample is cheap;
+// the samples inside a box are counted from the cell counts of each row.
 // Used internally for recovering the latent sample of a discrete copula.
 class BoxCovering
 {
@@ -125,43 +135,122 @@ public:
   explicit BoxCovering(const Eigen::MatrixXd& u, uint16_t K = 40);
   std::vector<size_t> get_box_indices(const Eigen::VectorXd& lower,
                                       const Eigen::VectorXd& upper) const;
+  ptrdiff_t sample_box_index(const Eigen::VectorXd& lower,
+                             const Eigen::VectorXd& upper,
+                             double w) const;
   void swap_sample(size_t i, const Eigen::VectorXd& new_sample);
 
 private:
-  struct Box
+  // a sample and its neighbors in the list of its cell (-1 if none)
+  struct Sample
   {
-  public:
-    Box(const std::vector<double>& lower, const std::vector<double>& upper);
-    std::vector<double> lower_;
-    std::vector<double> upper_;
-    std::set<size_t> indices_;
+    double u0;
+    double u1;
+    ptrdiff_t next;
+    ptrdiff_t prev;
   };
 
-  Eigen::MatrixXd u_;
+  size_t get_cell_bound(double u, bool upper) const;
+  size_t get_cell(size_t i) const;
+  void update_counts(size_t cell, bool add);
+  size_t count_row(size_t k, size_t j) const;
+  bool is_in_box(size_t i,
+                 const Eigen::VectorXd& lower,
+                 const Eigen::VectorXd& upper) const;
+
   size_t n_;
   uint16_t K_;
-  std::vector<std::vector<std::unique_ptr<Box>>> boxes_;
+  std::vector<Sample> samples_;
+  std::vector<size_t> cells_;       // cell of each sample (row-major)
+  std::vector<ptrdiff_t> first_;    // first sample of each cell (-1 if empty)
+  std::vector<size_t> cell_counts_; // number of samples in each cell
+  std::vector<size_t> row_counts_;  // Fenwick trees of the counts of each row
 };
 
 Eigen::MatrixXd
-find_latent_sample(const Eigen::MatrixXd& u, double b, size_t niter = 3);
+find_latent_sample(const Eigen::MatrixXd& u,
+                   double b,
+                   size_t niter = 3,
+                   size_t num_threads = 1);
 
 double
 pairwise_mcor(const Eigen::MatrixXd& x,
               const Eigen::VectorXd& weights = Eigen::VectorXd());
 
+double
+pairwise_mcor(const std::vector<size_t>& order0,
+              const std::vector<size_t>& order1,
+              const Eigen::VectorXd& weights = Eigen::VectorXd());
+
+Eigen::MatrixXd
+mcor_matrix(const Eigen::MatrixXd& x,
+            const Eigen::VectorXd& weights = Eigen::VectorXd(),
+            size_t num_threads = 1);
+
+Eigen::VectorXd
+ktau_pairs(const Eigen::MatrixXd& x,
+           const Eigen::VectorXd& weights = Eigen::VectorXd(),
+           size_t num_threads = 1);
+
 Eigen::MatrixXd
 dependence_matrix(const Eigen::MatrixXd& x, const std::string& measure);
 
+//! @brief A scrambled generalized Halton sequence whose points can be
+//! generated starting from any index (see `ghalton()`).
+class GhaltonSequence
+{
+public:
+  explicit GhaltonSequence(size_t d,
+                           const std::vector<int>& seeds = std::vector<int>());
+
+  size_t get_dim() const;
+
+  void generate(size_t begin, Eigen::Ref<Eigen::MatrixXd> out) const;
+  Eigen::MatrixXd generate(size_t begin, size_t n) const;
+
+private:
+  size_t d_;
+  Eigen::MatrixXi shift_; // d x 32 digits of the random shift
+};
+
+//! @brief A scrambled 64-bit Sobol sequence whose points can be generated
+//! starting from any index (see `sobol()`).
+class SobolSequence
+{
+public:
+  explicit SobolSequence(size_t d,
+                         const std::vector<int>& seeds = std::vector<int>(),
+                         const std::string& scrambling = "owen");
+
+  size_t get_dim() const;
+  std::string get_scrambling() const;
+
+  SobolSequence rescramble(const std::vector<int>& seeds) const;
+
+  void generate(size_t begin, Eigen::Ref<Eigen::MatrixXd> out) const;
+  Eigen::MatrixXd generate(size_t begin, size_t n) const;
+
+private:
+  void draw_scrambling(const std::vector<int>& seeds);
+
+  size_t d_;
+  std::string scrambling_;
+  // 64 direction numbers per dimension, shared by rescrambled copies
+  std::shared_ptr<const std::vector<uint64_t>> directions_;
+  std::vector<uint64_t> seeds_; // random shift or hash seed per dimension
+};
+
 Eigen::MatrixXd
 ghalton(const size_t& n,
         const size_t& d,
-        const std::vector<int>& seeds = std::vector<int>());
+        const std::vector<int>& seeds = std::vector<int>(),
+        size_t num_threads = 1);
 
 Eigen::MatrixXd
 sobol(const size_t& n,
       const size_t& d,
-      const std::vector<int>& seeds = std::vector<int>());
+      const std::vector<int>& seeds = std::vector<int>(),
+      size_t num_threads = 1);
 
 Eigen::VectorXd
 pbvt(const Eigen::MatrixXd& z, int nu, double rho);
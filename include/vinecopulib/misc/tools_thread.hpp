@@ -8,10 +8,22 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <future>
+#include <memory>
 #include <queue>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <vector>
+#include <vinecopulib/misc/cancellation.hpp>
+#include <vinecopulib/misc/tools_batch.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace vinecopulib {
 
@@ -51,7 +63,6 @@ private:
 
   bool has_errored();
   bool all_jobs_done();
-  bool wait_for_wake_up_event();
   void rethrow_exceptions();
 
   std::vector<std::thread> workers_;       // worker threads in the pool
@@ -132,16 +143,16 @@ ThreadPool::map(F&& f, I&& items)
 inline void
 ThreadPool::wait()
 {
-  while (true) {
-    if (wait_for_wake_up_event()) {
-      if (!this->all_jobs_done()) {
-        this->clear(); // cancel all remaining jobs
-        continue;      // wait for currently running jobs
-      }
-      if (this->has_errored() || this->all_jobs_done())
-        break;
+  {
+    std::unique_lock<std::mutex> lk(m_tasks_);
+    cv_busy_.wait(lk, [this] {
+      return this->all_jobs_done() || this->has_errored();
+    });
+    if (!this->all_jobs_done()) {
+      // cancel all remaining jobs and wait for currently running ones
+      std::queue<std::function<void()>>().swap(jobs_);
+      cv_busy_.wait(lk, [this] { return num_busy_ == 0; });
     }
-    std::this_thread::yield();
   }
 
   this->rethrow_exceptions();
@@ -173,16 +184,16 @@ ThreadPool::start_worker()
   workers_.emplace_back([this] {
     std::function<void()> job;
     // observe thread pool; only stop after all jobs are done
-    while ((!stopped_) | (!jobs_.empty())) {
+    while (true) {
       // must hold a lock while modifying shared variables
       std::unique_lock<std::mutex> lk(m_tasks_);
 
       // thread should wait when there is no job
       cv_tasks_.wait(lk, [this] { return stopped_ || !jobs_.empty(); });
 
-      // queue can be empty if thread pool is stopped
+      // queue can only be empty if thread pool is stopped
       if (jobs_.empty())
-        continue;
+        return;
 
       // take job from the queue
       job = std::move(jobs_.front());
@@ -195,7 +206,6 @@ ThreadPool::start_worker()
 
       this->do_job(std::move(job));
       this->announce_idle();
-      std::this_thread::yield();
     }
   });
 }
@@ -213,12 +223,11 @@ ThreadPool::do_job(std::function<void()>&& job)
   }
 }
 
-//! signals that a worker is busy (must be called why locking m_tasks_).
+//! signals that a worker is busy (must be called while locking m_tasks_).
 inline void
 ThreadPool::announce_busy()
 {
   ++num_busy_;
-  cv_busy_.notify_one();
 }
 
 //! signals that a worker is idle.
@@ -229,7 +238,7 @@ ThreadPool::announce_idle()
     std::lock_guard<std::mutex> lk(m_tasks_);
     --num_busy_;
   }
-  cv_busy_.notify_one();
+  cv_busy_.notify_all();
 }
 
 //! signals threads that no more new work is coming.
@@ -269,19 +278,6 @@ ThreadPool::all_jobs_done()
   return (num_busy_ == 0) && jobs_.empty();
 }
 
-//! checks whether `wait()` needs to wake up
-inline bool
-ThreadPool::wait_for_wake_up_event()
-{
-  static auto timeout = std::chrono::milliseconds(250);
-  auto wake_up_event_occured = [this] {
-    return this->all_jobs_done() || this->has_errored();
-  };
-  std::unique_lock<std::mutex> lk(m_tasks_);
-  cv_busy_.wait_for(lk, timeout, wake_up_event_occured);
-  return wake_up_event_occured();
-}
-
 //! rethrows exceptions (exceptions from workers are caught and stored; the
 //! wait loop only checks, but does not throw exceptions)
 inline void
@@ -291,5 +287,620 @@ ThreadPool::rethrow_exceptions()
     std::rethrow_exception(error_ptr_);
 }
 
+//! @brief Gets the CPUs of each NUMA node.
+//!
+//! @details On Linux, the nodes are read from
+//! `/sys/devices/system/node/node<k>/cpulist`. If this fails (or on other
+//! platforms), a single node containing all CPUs is returned.
+inline std::vector<std::vector<size_t>>
+get_numa_nodes()
+{
+  std::vector<std::vector<size_t>> nodes;
+#if defined(__linux__)
+  for (size_t k = 0;; ++k) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(k) +
+                       "/cpulist");
+    if (!file)
+      break;
+    // cpulist has the format "0-3,8-11"
+    std::vector<size_t> cpus;
+    std::string range;
+    while (std::getline(file, range, ',')) {
+      std::istringstream is(range);
+      size_t first, last;
+      if (!(is >> first))
+        continue;
+      last = first;
+      if (is.get() == '-')
+        is >> last;
+      for (size_t cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(cpu);
+    }
+    if (!cpus.empty())
+      nodes.push_back(cpus);
+  }
+#endif
+  if (nodes.empty()) {
+    nodes.emplace_back();
+    for (size_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+      nodes[0].push_back(cpu);
+  }
+  return nodes;
+}
+
+//! A work-stealing executor.
+//!
+//! Each worker owns a deque of jobs. Workers take jobs from the back of their
+//! own deque and, if it is empty, steal from the front of the others. Jobs
+//! pushed from outside the executor are distributed round-robin; jobs pushed
+//! from within a job go to the deque of the worker running it.
+//!
+//! Workers can be pinned to CPUs (see `get_numa_nodes()`). Worker `w` then
+//! runs on the `w`-th CPU when CPUs are ordered by NUMA node, so workers with
+//! neighboring indices share a node. `parallel_for()` then assigns one
+//! contiguous range of indices to each worker, so that data touched first in
+//! a batch stays on the node of the worker processing it.
+class Executor
+{
+public:
+  Executor(Executor&&) = delete;
+  Executor(const Executor&) = delete;
+  explicit Executor(size_t num_workers, bool pin_workers = false);
+
+  ~Executor() noexcept;
+
+  Executor& operator=(const Executor&) = delete;
+  Executor& operator=(Executor&& other) = delete;
+
+  template<class F>
+  void push(F&& f);
+
+  template<class F>
+  void push_to(size_t worker, F&& f);
+
+  size_t get_num_workers() const;
+  bool pins_workers() const;
+  bool is_worker() const;
+
+private:
+  struct Worker
+  {
+    std::deque<std::function<void()>> jobs;
+    std::mutex m;
+  };
+
+  void run_worker(size_t id);
+  static void pin_to_cpu(size_t cpu);
+  bool try_pop(size_t id, std::function<void()>& job);
+  static Executor*& current_executor();
+  static size_t& current_worker();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_worker_{ 0 };
+  bool pin_workers_{ false };
+
+  // jobs that have been pushed, but not yet claimed by a worker
+  std::mutex m_jobs_;
+  std::condition_variable cv_jobs_;
+  size_t num_jobs_{ 0 };
+  bool stopped_{ false };
+};
+
+//! constructs an executor with `num_workers` worker threads.
+//! @param num_workers Number of worker threads to create; if
+//!   `num_workers = 0`, all jobs are done in the thread pushing them.
+//! @param pin_workers Whether to pin the workers to CPUs (only supported on
+//!   Linux; ignored elsewhere).
+inline Executor::Executor(size_t num_workers, bool pin_workers)
+{
+#if defined(__linux__)
+  pin_workers_ = pin_workers;
+#else
+  (void)pin_workers;
+#endif
+  std::vector<size_t> cpus;
+  if (pin_workers_) {
+    for (const auto& node : get_numa_nodes())
+      cpus.insert(cpus.end(), node.begin(), node.end());
+    pin_workers_ = !cpus.empty();
+  }
+  for (size_t w = 0; w < num_workers; ++w)
+    workers_.emplace_back(new Worker);
+  for (size_t w = 0; w < num_workers; ++w) {
+    threads_.emplace_back([this, w, cpus] {
+      if (pin_workers_)
+        pin_to_cpu(cpus[w % cpus.size()]);
+      this->run_worker(w);
+    });
+  }
+}
+
+//! destructor finishes all jobs and joins the worker threads.
+inline Executor::~Executor() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lk(m_jobs_);
+    stopped_ = true;
+  }
+  cv_jobs_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable())
+      thread.join();
+  }
+}
+
+//! pushes a job to the executor.
+//! @param f A function without arguments; it must not throw.
+template<class F>
+void
+Executor::push(F&& f)
+{
+  if (workers_.size() == 0) {
+    f(); // if there are no workers, do the job in the calling thread
+    return;
+  }
+  size_t id = this->is_worker() ? current_worker()
+                                : next_worker_++ % workers_.size();
+  this->push_to(id, std::forward<F>(f));
+}
+
+//! pushes a job to the deque of a specific worker.
+//!
+//! @details The job is done by this worker unless another worker runs out of
+//! jobs and steals it.
+//! @param worker The index of the worker.
+//! @param f A function without arguments; it must not throw.
+template<class F>
+void
+Executor::push_to(size_t worker, F&& f)
+{
+  if (workers_.size() == 0) {
+    f();
+    return;
+  }
+  worker = worker % workers_.size();
+  {
+    std::lock_guard<std::mutex> lk(workers_[worker]->m);
+    workers_[worker]->jobs.emplace_back(std::forward<F>(f));
+  }
+  {
+    // the job must be in a deque before it can be claimed
+    std::lock_guard<std::mutex> lk(m_jobs_);
+    ++num_jobs_;
+  }
+  cv_jobs_.notify_one();
+}
+
+//! gets the number of worker threads.
+inline size_t
+Executor::get_num_workers() const
+{
+  return threads_.size();
+}
+
+//! checks whether the workers are pinned to CPUs.
+inline bool
+Executor::pins_workers() const
+{
+  return pin_workers_;
+}
+
+//! checks whether the calling thread is a worker of the executor.
+inline bool
+Executor::is_worker() const
+{
+  return current_executor() == this;
+}
+
+//! pins the calling thread to a CPU.
+//! @param cpu The index of the CPU.
+inline void
+Executor::pin_to_cpu(size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  // pinning is an optimization; the worker keeps running if it fails
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+#else
+  (void)cpu;
+#endif
+}
+
+//! runs jobs until the executor is stopped and no jobs are left.
+//! @param id The index of the worker.
+inline void
+Executor::run_worker(size_t id)
+{
+  current_executor() = this;
+  current_worker() = id;
+  std::function<void()> job;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(m_jobs_);
+      cv_jobs_.wait(lk, [this] { return stopped_ || (num_jobs_ > 0); });
+      if (num_jobs_ == 0)
+        return; // stopped and no jobs left
+      --num_jobs_;
+    }
+    // a job has been claimed, so there is at least one in the deques
+    while (!this->try_pop(id, job)) {
+    }
+    job();
+    job = nullptr;
+  }
+}
+
+//! takes a job from the worker's own deque or steals one from another.
+//! @param id The index of the worker.
+//! @param job Where to put the job.
+//! @return Whether a job was found.
+inline bool
+Executor::try_pop(size_t id, std::function<void()>& job)
+{
+  {
+    std::lock_guard<std::mutex> lk(workers_[id]->m);
+    if (!workers_[id]->jobs.empty()) {
+      job = std::move(workers_[id]->jobs.back());
+      workers_[id]->jobs.pop_back();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < workers_.size(); ++k) {
+    auto& other = workers_[(id + k) % workers_.size()];
+    std::lock_guard<std::mutex> lk(other->m);
+    if (!other->jobs.empty()) {
+      job = std::move(other->jobs.front());
+      other->jobs.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+//! the executor the calling thread is a worker of (if any).
+inline Executor*&
+Executor::current_executor()
+{
+  static thread_local Executor* executor = nullptr;
+  return executor;
+}
+
+//! the index of the calling thread among the executor's workers.
+inline size_t&
+Executor::current_worker()
+{
+  static thread_local size_t id = 0;
+  return id;
+}
+
+//! the executor used for parallel computations (`nullptr` until first use).
+inline std::shared_ptr<Executor>&
+executor_instance()
+{
+  static std::shared_ptr<Executor> executor;
+  return executor;
+}
+
+inline std::mutex&
+executor_mutex()
+{
+  static std::mutex m;
+  return m;
+}
+
+//! @brief Gets the executor used for parallel computations.
+//!
+//! @details The executor is shared by all computations in the process and
+//! started on first use, with as many workers as there are cores (see also
+//! `set_executor()`).
+inline std::shared_ptr<Executor>
+get_executor()
+{
+  std::lock_guard<std::mutex> lk(executor_mutex());
+  auto& executor = executor_instance();
+  if (!executor) {
+    executor = std::make_shared<Executor>(std::thread::hardware_concurrency());
+  }
+  return executor;
+}
+
+//! @brief Sets the executor used for parallel computations.
+//!
+//! @details Computations that are already running keep using the previous
+//! executor.
+//! @param executor The new executor; if `nullptr`, a default executor is
+//!   started on next use.
+inline void
+set_executor(std::shared_ptr<Executor> executor)
+{
+  std::lock_guard<std::mutex> lk(executor_mutex());
+  executor_instance() = executor;
+}
+
+//! A group of tasks running on the executor (see `get_executor()`).
+//!
+//! Tasks pushed to the group are queued in the group and taken one by one by
+//! up to `num_threads - 1` jobs on the executor and the thread calling
+//! `wait()`. `wait()` blocks until all tasks of the group are done, including
+//! those pushed by other tasks of the group. While waiting, the calling
+//! thread runs tasks that haven't started yet, so it never waits for a task
+//! that no thread is working on; groups may therefore be used within tasks of
+//! other groups.
+class TaskGroup
+{
+public:
+  TaskGroup(TaskGroup&&) = delete;
+  TaskGroup(const TaskGroup&) = delete;
+  explicit TaskGroup(size_t num_threads);
+
+  ~TaskGroup() noexcept;
+
+  TaskGroup& operator=(const TaskGroup&) = delete;
+  TaskGroup& operator=(TaskGroup&& other) = delete;
+
+  template<class F, class... Args>
+  void push(F&& f, Args&&... args);
+
+  template<class F, class I>
+  void map(F&& f, I&& items);
+
+  void wait();
+
+private:
+  // shared with the jobs on the executor, which may start after the group
+  // is gone
+  struct State
+  {
+    std::deque<std::function<void()>> tasks; // tasks that haven't started
+    size_t num_unfinished{ 0 };
+    size_t num_runners{ 0 };
+    std::exception_ptr error_ptr;
+    std::mutex m;
+    std::condition_variable cv;
+  };
+
+  static void run_next_task(State& state, std::unique_lock<std::mutex>& lk);
+
+  size_t max_runners_{ 0 };
+  std::shared_ptr<Executor> executor_;
+  std::shared_ptr<State> state_;
+};
+
+//! constructs a task group.
+//! @param num_threads The maximal number of threads working on the group's
+//!   tasks at the same time; if `num_threads <= 1`, tasks are done
+//!   immediately in the thread pushing them.
+inline TaskGroup::TaskGroup(size_t num_threads)
+  : state_(std::make_shared<State>())
+{
+  if (num_threads > 1) {
+    executor_ = get_executor();
+    max_runners_ = std::min(num_threads - 1, executor_->get_num_workers());
+  }
+}
+
+//! destructor waits for all tasks to finish.
+inline TaskGroup::~TaskGroup() noexcept
+{
+  // destructors should never throw
+  try {
+    this->wait();
+  } catch (...) {
+  }
+}
+
+//! pushes a task to the group.
+//! @param f A function taking an arbitrary number of arguments.
+//! @param args A comma-seperated list of the other arguments that shall
+//!   be passed to `f`.
+template<class F, class... Args>
+void
+TaskGroup::push(F&& f, Args&&... args)
+{
+  if (max_runners_ == 0) {
+    f(args...); // no other threads, do the task in the calling thread
+    return;
+  }
+
+  bool needs_runner;
+  {
+    // tasks run under the cancellation token of the thread pushing them
+    auto token = CancellationScope::get_current();
+    std::lock_guard<std::mutex> lk(state_->m);
+    state_->tasks.emplace_back([f, args..., token] {
+      CancellationScope scope(token);
+      f(args...);
+    });
+    ++state_->num_unfinished;
+    needs_runner = (state_->num_runners < max_runners_);
+    if (needs_runner)
+      ++state_->num_runners;
+  }
+  if (needs_runner) {
+    auto state = state_;
+    executor_->push([state] {
+      std::unique_lock<std::mutex> lk(state->m);
+      while (!state->tasks.empty())
+        run_next_task(*state, lk);
+      --state->num_runners;
+    });
+  } else {
+    // a thread in wait() may help out
+    state_->cv.notify_all();
+  }
+}
+
+//! maps a function on a list of items, possibly running tasks in parallel.
+//! @param f Function to be mapped.
+//! @param items An objects containing the items on which `f` shall be
+//!   mapped; must allow for `auto` loops (i.e., `std::begin(I)`/
+//!  `std::end(I)` must be defined).
+template<class F, class I>
+void
+TaskGroup::map(F&& f, I&& items)
+{
+  for (auto&& item : items)
+    this->push(f, item);
+}
+
+//! waits for all tasks to finish.
+//!
+//! @details If a task throws, the remaining tasks of the group are skipped
+//! and the first exception is rethrown.
+inline void
+TaskGroup::wait()
+{
+  std::unique_lock<std::mutex> lk(state_->m);
+  while (true) {
+    state_->cv.wait(lk, [this] {
+      return (state_->num_unfinished == 0) || !state_->tasks.empty();
+    });
+    if (state_->num_unfinished == 0)
+      break;
+    run_next_task(*state_, lk);
+  }
+
+  if (state_->error_ptr) {
+    auto error_ptr = state_->error_ptr;
+    state_->error_ptr = nullptr;
+    std::rethrow_exception(error_ptr);
+  }
+}
+
+//! runs the next task of the group (`lk` must hold the lock on `state.m`,
+//! which is released while the task runs).
+inline void
+TaskGroup::run_next_task(State& state, std::unique_lock<std::mutex>& lk)
+{
+  auto task = std::move(state.tasks.front());
+  state.tasks.pop_front();
+  if (!state.error_ptr) {
+    lk.unlock();
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> lk_error(state.m);
+      if (!state.error_ptr)
+        state.error_ptr = std::current_exception();
+    }
+    task = nullptr; // release captured resources before signaling
+    lk.lock();
+  }
+  if (--state.num_unfinished == 0)
+    state.cv.notify_all();
+}
+
+//! applies a function to batches of an index range on pinned workers (see
+//! `parallel_for()`).
+template<class F>
+void
+parallel_for_pinned(size_t begin,
+                    size_t end,
+                    F& f,
+                    size_t num_threads,
+                    size_t grain,
+                    Executor& executor)
+{
+  size_t num_tasks = end - begin;
+  grain = std::max(static_cast<size_t>(1), grain);
+  size_t num_parts = std::min(num_threads, executor.get_num_workers());
+  num_parts = std::max(static_cast<size_t>(1),
+                       std::min(num_parts, num_tasks / grain));
+  if (num_parts == 1) {
+    for (const auto& b : tools_batch::create_batches(num_tasks, 1, grain))
+      f(tools_batch::Batch{ begin + b.begin, b.size });
+    return;
+  }
+
+  struct State
+  {
+    size_t num_left;
+    std::exception_ptr error_ptr;
+    std::mutex m;
+    std::condition_variable cv;
+  } state;
+  state.num_left = num_parts;
+
+  for (size_t k = 0; k < num_parts; ++k) {
+    size_t part_begin = begin + k * num_tasks / num_parts;
+    size_t part_size = begin + (k + 1) * num_tasks / num_parts - part_begin;
+    auto token = CancellationScope::get_current();
+    executor.push_to(k, [&state, &f, part_begin, part_size, grain, token] {
+      CancellationScope scope(token);
+      try {
+        for (const auto& b :
+             tools_batch::create_batches(part_size, 1, grain)) {
+          {
+            std::lock_guard<std::mutex> lk(state.m);
+            if (state.error_ptr)
+              break;
+          }
+          f(tools_batch::Batch{ part_begin + b.begin, b.size });
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lk(state.m);
+        if (!state.error_ptr)
+          state.error_ptr = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lk(state.m);
+      if (--state.num_left == 0)
+        state.cv.notify_all();
+    });
+  }
+
+  std::unique_lock<std::mutex> lk(state.m);
+  state.cv.wait(lk, [&state] { return state.num_left == 0; });
+  if (state.error_ptr)
+    std::rethrow_exception(state.error_ptr);
+}
+
+//! @brief Applies a function to batches of an index range in parallel.
+//!
+//! @details The range is split into batches of at least `grain` indices (see
+//! `tools_batch::create_batches()`), which are processed as tasks of a
+//! `TaskGroup` with `num_threads` threads.
+//!
+//! If the executor pins its workers to CPUs (see `Executor`), the range is
+//! instead split into one contiguous part per worker, and each part is pushed
+//! to the deque of its worker, which processes the part's batches in order.
+//! Memory that is first touched in a batch is then allocated on the NUMA node
+//! of the worker using it.
+//! @param begin First index of the range.
+//! @param end One past the last index of the range.
+//! @param f A function taking a `tools_batch::Batch` as argument.
+//! @param num_threads The number of threads to use; the batches are
+//!   processed in the calling thread if `num_threads <= 1`.
+//! @param grain The minimal number of indices per batch.
+template<class F>
+void
+parallel_for(size_t begin,
+             size_t end,
+             F&& f,
+             size_t num_threads,
+             size_t grain = 1)
+{
+  if (num_threads > 1) {
+    auto executor = get_executor();
+    if (executor->pins_workers() && !executor->is_worker()) {
+      parallel_for_pinned(begin, end, f, num_threads, grain, *executor);
+      return;
+    }
+  }
+
+  auto batches = tools_batch::create_batches(end - begin, num_threads, grain);
+  for (auto& batch : batches) {
+    batch.begin += begin;
+  }
+  if (batches.size() == 1) {
+    num_threads = 1;
+  }
+  TaskGroup group(num_threads);
+  group.map([&f](const tools_batch::Batch& b) { f(b); }, batches);
+  group.wait();
+}
+
 }
 }
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <functional>
 #include <vinecopulib/vinecop/fit_controls.hpp>
 #include <vinecopulib/vinecop/rvine_structure.hpp>
 
@@ -116,6 +117,7 @@ public:
   double get_threshold() const;
   double get_loglik() const;
   size_t get_nobs() const;
+  bool is_partial() const;
   double get_aic() const;
   double get_bic() const;
   double get_mbicv(const double psi0 = 0.9) const;
@@ -179,6 +181,7 @@ protected:
   double loglik_{ NAN };
   size_t nobs_{ 0 };
   mutable std::vector<std::string> var_types_;
+  bool partial_{ false };
 
   void check_data_dim(const Eigen::MatrixXd& data) const;
   void check_data(const Eigen::MatrixXd& data) const;
@@ -186,6 +189,14 @@ protected:
     const std::vector<std::vector<Bicop>>& pair_copulas) const;
   double calculate_mbicv_penalty(const size_t nobs, const double psi0) const;
   void finalize_fit(const tools_select::VinecopSelector& selector);
+  void fit_pair_copulas(
+    const Eigen::MatrixXd& u,
+    size_t trunc_lvl,
+    size_t num_threads,
+    const std::function<void(size_t, size_t, const Eigen::MatrixXd&)>& fit_edge);
+  void select_pair_copulas(const Eigen::MatrixXd& u,
+                           size_t trunc_lvl,
+                           const FitControlsVinecop& controls);
   void check_weights_size(const Eigen::VectorXd& weights,
                           const Eigen::MatrixXd& data) const;
   void check_enough_data(const Eigen::MatrixXd& data) const;
@@ -196,6 +207,7 @@ protected:
   void set_var_types_internal(const std::vector<std::string>& var_types) const;
   int get_n_discrete() const;
   bool is_discrete() const;
+  double get_eval_cost(size_t trunc_lvl, bool inverse) const;
   Eigen::MatrixXd collapse_data(const Eigen::MatrixXd& u) const;
 };
 }
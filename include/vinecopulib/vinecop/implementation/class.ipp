@@ -5,9 +5,11 @@
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
 #include <vinecopulib/bicop/class.hpp>
+#include <vinecopulib/misc/tools_eigen.hpp>
 #include <vinecopulib/misc/tools_interface.hpp>
 #include <vinecopulib/misc/tools_serialization.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
+#include <vinecopulib/misc/tools_stats_sobol.hpp>
 #include <vinecopulib/misc/tools_stl.hpp>
 #include <vinecopulib/vinecop/tools_select.hpp>
 
@@ -299,6 +301,23 @@ Vinecop::make_pair_copula_store(const size_t d, const size_t trunc_lvl)
 //! discarded before fitting a pair-copula. This is done on a pair-by-pair basis
 //! so that the maximal available information is used.
 //!
+//! If `controls.get_warm_start()` is true and the structure is known for all
+//! trees to be selected, the current pair-copulas are used as starting points
+//! (see `Bicop::select()`). This is useful to refit a model on new data.
+//!
+//! If the structure is known for all trees to be selected, a pair-copula is
+//! selected as soon as its parent edges in the previous tree are done, so that
+//! all threads are kept busy also in the last trees.
+//!
+//! If `controls.get_cancellation_token()` is cancelled while the trees are
+//! selected one after another, the model keeps the trees that were completed
+//! before (or, in a threshold or truncation level search, the best model of
+//! the previous iterations) and `is_partial()` returns `true`. If no tree was
+//! completed or the pair-copulas are pipelined, a `CancelledException` is
+//! thrown.
+//!
+//! Progress and timing of the trees, edges, and fits are reported to
+//! `controls.get_observer()` (see `Observer`).
 //!
 //! @param data \f$ n \times (d + k) \f$ or \f$ n \times 2d \f$ matrix of
 //!   observations, where \f$ k \f$ is the number of discrete variables.
@@ -306,6 +325,8 @@ Vinecop::make_pair_copula_store(const size_t d, const size_t trunc_lvl)
 inline void
 Vinecop::select(const Eigen::MatrixXd& data, const FitControlsVinecop& controls)
 {
+  CancellationScope cancellation_scope(controls.get_cancellation_token());
+  partial_ = false;
   if (controls.get_select_families()) {
     check_data(data);
     if (d_ == 1) {
@@ -315,8 +336,21 @@ Vinecop::select(const Eigen::MatrixXd& data, const FitControlsVinecop& controls)
     }
     Eigen::MatrixXd u = collapse_data(data);
 
+    size_t trunc_lvl = std::min(controls.get_trunc_lvl(), d_ - 1);
+    bool structure_known = (trunc_lvl <= rvine_structure_.get_trunc_lvl());
+    if (structure_known && (trunc_lvl > 0) && !controls.needs_sparse_select() &&
+        !controls.get_show_trace()) {
+      // no trees to select, pair-copulas can be pipelined across trees
+      select_pair_copulas(u, trunc_lvl, controls);
+      return;
+    }
+
     tools_select::VinecopSelector selector(
       u, rvine_structure_, controls, var_types_);
+    if (controls.get_warm_start() && structure_known) {
+      // structure is known for all trees, current model is a starting point
+      selector.set_warm_start_pair_copulas(pair_copulas_);
+    }
     if (controls.needs_sparse_select()) {
       selector.sparse_select_all_trees(u);
     } else {
@@ -337,6 +371,13 @@ Vinecop::select(const Eigen::MatrixXd& data, const FitControlsVinecop& controls)
 //! and a `FitControlsVinecop` object instantiated
 //! with `select_families = false`.
 //!
+//! If `controls.get_cancellation_token()` is cancelled, a
+//! `CancelledException` is thrown; some pair-copulas may have been refitted
+//! already.
+//!
+//! The fits of the pair-copulas are reported to `controls.get_observer()`
+//! (see `Observer`).
+//!
 //! @param data \f$ n \times (d + k) \f$ or \f$ n \times 2d \f$ matrix of
 //!   observations, where \f$ k \f$ is the number of discrete variables.
 //! @param controls The controls for each bivariate fit (see
@@ -347,94 +388,32 @@ Vinecop::fit(const Eigen::MatrixXd& data,
              const FitControlsBicop& controls,
              const size_t num_threads)
 {
+  CancellationScope cancellation_scope(controls.get_cancellation_token());
+  partial_ = false;
   check_data(data);
   auto u = collapse_data(data);
 
-  // info about the vine structure (reverse rows (!) for more natural indexing)
   size_t trunc_lvl = rvine_structure_.get_trunc_lvl();
   if (trunc_lvl == 0)
     return;
 
-  auto order = rvine_structure_.get_order();
-  auto disc_cols = tools_select::get_disc_cols(var_types_);
-  size_t n = u.rows();
-
-  // temporary storage objects (all data must be in (0, 1))
-  Eigen::MatrixXd hfunc1, hfunc2, hfunc1_sub, hfunc2_sub;
-  hfunc1 = Eigen::MatrixXd::Zero(n, d_);
-  hfunc2 = Eigen::MatrixXd::Zero(n, d_);
-  if (get_n_discrete() > 0) {
-    hfunc1_sub = hfunc1;
-    hfunc2_sub = hfunc2;
-  }
-
-  // set up thread pool
-  tools_thread::ThreadPool pool((num_threads == 1) ? 0 : num_threads);
-
-  // fill first row of hfunc2 matrix with observed data;
-  // points have to be reordered to correspond to natural order
-  for (size_t j = 0; j < d_; ++j) {
-    hfunc2.col(j) = u.col(order[j] - 1);
-    if (var_types_[order[j] - 1] == "d") {
-      hfunc2_sub.col(j) = u.col(d_ + disc_cols[order[j] - 1]);
+  auto observer = controls.get_observer();
+  auto fit_edge = [&](size_t tree, size_t edge, const Eigen::MatrixXd& u_e) {
+    Bicop& pc = pair_copulas_[tree][edge];
+    ObserverTimer timer(observer.get());
+    pc.fit(u_e, controls);
+    if (observer) {
+      observer->on_edge({ tree,
+                          edge,
+                          pc.get_family(),
+                          pc.get_rotation(),
+                          pc.get_num_objective_calls(),
+                          timer.get_seconds() });
     }
-  }
-
-  for (size_t tree = 0; tree < trunc_lvl; ++tree) {
-    tools_interface::check_user_interrupt();
-    auto fit_edge = [&](size_t edge) {
-      tools_interface::check_user_interrupt(edge % 5 == 0);
-      // extract evaluation point from hfunction matrices (have been
-      // computed in previous tree level)
-      Bicop* edge_copula = &pair_copulas_[tree][edge];
-      auto var_types = edge_copula->get_var_types();
-      size_t m = rvine_structure_.min_array(tree, edge);
-
-      auto u_e = Eigen::MatrixXd(n, 2), u_e_sub = Eigen::MatrixXd(n, 2);
-      u_e.col(0) = hfunc2.col(edge);
-      if (m == rvine_structure_.struct_array(tree, edge, true)) {
-        u_e.col(1) = hfunc2.col(m - 1);
-      } else {
-        u_e.col(1) = hfunc1.col(m - 1);
-      }
-
-      if ((var_types[0] == "d") || (var_types[1] == "d")) {
-        u_e.conservativeResize(n, 4);
-        u_e.col(2) = hfunc2_sub.col(edge);
-        if (m == rvine_structure_.struct_array(tree, edge, true)) {
-          u_e.col(3) = hfunc2_sub.col(m - 1);
-        } else {
-          u_e.col(3) = hfunc1_sub.col(m - 1);
-        }
-      }
-
-      edge_copula->fit(u_e, controls);
-
-      // h-functions are only evaluated if needed in next tree
-      if (rvine_structure_.needed_hfunc1(tree, edge)) {
-        hfunc1.col(edge) = edge_copula->hfunc1(u_e);
-        if (var_types[1] == "d") {
-          u_e_sub = u_e;
-          u_e_sub.col(1) = u_e.col(3);
-          hfunc1_sub.col(edge) = edge_copula->hfunc1(u_e_sub);
-        }
-      }
-      if (rvine_structure_.needed_hfunc2(tree, edge)) {
-        hfunc2.col(edge) = edge_copula->hfunc2(u_e);
-        if (var_types[0] == "d") {
-          u_e_sub = u_e;
-          u_e_sub.col(0) = u_e.col(2);
-          hfunc2_sub.col(edge) = edge_copula->hfunc2(u_e_sub);
-        }
-      }
-    };
-
-    pool.map(fit_edge, tools_stl::seq_int(0, d_ - tree - 1));
-    pool.wait();
-  }
-  pool.join();
+  };
+  fit_pair_copulas(u, trunc_lvl, num_threads, fit_edge);
 
-  loglik_ = 0, nobs_ = n;
+  loglik_ = 0, nobs_ = u.rows();
   for (size_t tree = 0; tree < trunc_lvl; ++tree) {
     for (size_t edge = 0; edge < d_ - tree - 1; ++edge) {
         loglik_ += pair_copulas_[tree][edge].get_loglik();
@@ -715,6 +694,17 @@ Vinecop::get_nobs() const
   return nobs_;
 }
 
+//! @brief Checks whether the model is the partial result of a cancelled
+//! call to `select()`.
+//!
+//! @details A partial model contains the trees that were completely selected
+//! before the cancellation (see `FitControlsBicop::set_cancellation_token()`).
+inline bool
+Vinecop::is_partial() const
+{
+  return partial_;
+}
+
 //! @brief Gets the AIC.
 //!
 //! The function throws an error if model has not been fitted to data.
@@ -910,10 +900,16 @@ Vinecop::pdf(Eigen::MatrixXd u, const size_t num_threads) const
   auto order = rvine_structure_.get_order();
   auto disc_cols = tools_select::get_disc_cols(var_types_);
 
-  // initial value must be 1.0 for multiplication
-  Eigen::VectorXd pdf = Eigen::VectorXd::Constant(u.rows(), 1.0);
+  // initialized in the batches, so that each batch touches its part of the
+  // output first
+  Eigen::VectorXd pdf(u.rows());
 
+  auto observer = ObserverScope::get_current();
   auto do_batch = [&](const tools_batch::Batch& b) {
+    ObserverTimer timer(observer.get());
+    // initial value must be 1.0 for multiplication
+    pdf.segment(b.begin, b.size).setOnes();
+
     // temporary storage objects (all data must be in (0, 1))
     Eigen::MatrixXd hfunc1, hfunc2, u_e, hfunc1_sub, hfunc2_sub, u_e_sub;
     hfunc1 = Eigen::MatrixXd::Zero(b.size, d_);
@@ -984,12 +980,17 @@ Vinecop::pdf(Eigen::MatrixXd u, const size_t num_threads) const
         }
       }
     }
+    if (observer) {
+      observer->on_batch({ "pdf", b.begin, b.size, timer.get_seconds() });
+    }
   };
 
   if (trunc_lvl > 0) {
-    tools_thread::ThreadPool pool((num_threads == 1) ? 0 : num_threads);
-    pool.map(do_batch, tools_batch::create_batches(u.rows(), num_threads));
-    pool.join();
+    size_t grain =
+      tools_batch::compute_min_batch_size(get_eval_cost(trunc_lvl, false));
+    tools_thread::parallel_for(0, u.rows(), do_batch, num_threads, grain);
+  } else {
+    pdf.setOnes();
   }
 
   return pdf;
@@ -1015,7 +1016,8 @@ Vinecop::pdf(Eigen::MatrixXd u, const size_t num_threads) const
 //!   evaluation points, where \f$ k \f$ is the number of discrete variables
 //!   (see `Vinecop::select()`).
 //! @param N Integer for the number of quasi-random numbers to draw
-//! to evaluate the distribution (default: 1e4).
+//! to evaluate the distribution (default: 1e4); the numbers are taken from
+//! an Owen-scrambled Sobol sequence (see `tools_stats::sobol()`).
 //! @param num_threads The number of threads to use for computations; if greater
 //!   than 1, the function will generate `n` samples concurrently in
 //!   `num_threads` batches.
@@ -1028,17 +1030,19 @@ Vinecop::cdf(const Eigen::MatrixXd& u,
              const size_t num_threads,
              std::vector<int> seeds) const
 {
-  if (d_ > 21201) {
+  if (d_ > tools_stats::tools_sobol::max_dim) {
     std::stringstream message;
     message << "cumulative distribution available for models of "
-            << "dimension 21201 or less. This model's dimension: " << d_
+            << "dimension " << tools_stats::tools_sobol::max_dim
+            << " or less. This model's dimension: " << d_
             << std::endl;
     throw std::runtime_error(message.str().c_str());
   }
   check_data(u);
 
   // Simulate N quasi-random numbers from the vine model
-  auto u_sim = simulate(N, true, num_threads, seeds);
+  auto u_sim = inverse_rosenblatt(
+    tools_stats::sobol(N, d_, seeds, num_threads), num_threads);
 
   size_t n = u.rows();
   Eigen::VectorXd vine_distribution(n);
@@ -1064,7 +1068,7 @@ Vinecop::cdf(const Eigen::MatrixXd& u,
 //! @param qrng Set to true for quasi-random numbers.
 //! @param num_threads The number of threads to use for computations; if greater
 //!   than 1, the function will generate `n` samples concurrently in
-//!   `num_threads` batches.
+//!   `num_threads` batches (including the quasi-random numbers).
 //! @param seeds Seeds of the random number generator; if empty (default),
 //!   the random number generator is seeded randomly.
 //! @return An \f$ n \times d \f$ matrix of samples from the copula model.
@@ -1074,9 +1078,8 @@ Vinecop::simulate(const size_t n,
                   const size_t num_threads,
                   const std::vector<int>& seeds) const
 {
-  auto u = tools_stats::simulate_uniform(n, d_, qrng, seeds);
+  auto u = tools_stats::simulate_uniform(n, d_, qrng, seeds, num_threads);
   return inverse_rosenblatt(u, num_threads);
-  ;
 }
 
 //! @brief Evaluates the log-likelihood.
@@ -1261,29 +1264,34 @@ Vinecop::rosenblatt(Eigen::MatrixXd u,
   auto inverse_order = tools_stl::invert_permutation(order);
   auto disc_cols = tools_select::get_disc_cols(var_types_);
 
-  // fill first row of hfunc2 matrix with evaluation points;
-  // points have to be reordered to correspond to natural order
+  // filled in the batches, so that each batch touches its rows first
   Eigen::MatrixXd hfunc1(n, d), hfunc2(n, d), hfunc1_sub(n, d),
     hfunc2_sub(n, d);
-  for (size_t j = 0; j < d; ++j) {
-    hfunc2.col(j) = u.col(order[j] - 1);
-  }
-  hfunc1 = hfunc2; // just ensure data is in [0, 1]^d
-  if (is_discrete()) {
-    hfunc1_sub = hfunc1;
-    hfunc2_sub = hfunc2;
-  }
 
-  // fill first row of hfunc2 matrix with evaluation points;
-  // points have to be reordered to correspond to natural order
-  for (size_t j = 0; j < d_; ++j) {
-    hfunc2.col(j) = u.col(order[j] - 1);
-    if (var_types_[order[j] - 1] == "d") {
-      hfunc2_sub.col(j) = u.col(d_ + disc_cols[order[j] - 1]);
+  auto observer = ObserverScope::get_current();
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    ObserverTimer timer(observer.get());
+    // fill first row of hfunc2 matrix with evaluation points;
+    // points have to be reordered to correspond to natural order
+    for (size_t j = 0; j < d; ++j) {
+      hfunc2.block(b.begin, j, b.size, 1) =
+        u.block(b.begin, order[j] - 1, b.size, 1);
+    }
+    // just ensure data is in [0, 1]^d
+    hfunc1.middleRows(b.begin, b.size) = hfunc2.middleRows(b.begin, b.size);
+    if (is_discrete()) {
+      hfunc1_sub.middleRows(b.begin, b.size) =
+        hfunc1.middleRows(b.begin, b.size);
+      hfunc2_sub.middleRows(b.begin, b.size) =
+        hfunc2.middleRows(b.begin, b.size);
+      for (size_t j = 0; j < d; ++j) {
+        if (var_types_[order[j] - 1] == "d") {
+          hfunc2_sub.block(b.begin, j, b.size, 1) =
+            u.block(b.begin, d_ + disc_cols[order[j] - 1], b.size, 1);
+        }
+      }
     }
-  }
 
-  auto do_batch = [&](const tools_batch::Batch& b) {
     Eigen::MatrixXd u_e, u_e_sub;
     for (size_t tree = 0; tree < trunc_lvl; ++tree) {
       tools_interface::check_user_interrupt(
@@ -1333,12 +1341,18 @@ Vinecop::rosenblatt(Eigen::MatrixXd u,
         }
       }
     }
+    if (observer) {
+      observer->on_batch(
+        { "rosenblatt", b.begin, b.size, timer.get_seconds() });
+    }
   };
 
   if (trunc_lvl > 0) {
-    tools_thread::ThreadPool pool((num_threads == 1) ? 0 : num_threads);
-    pool.map(do_batch, tools_batch::create_batches(n, num_threads));
-    pool.join();
+    size_t grain =
+      tools_batch::compute_min_batch_size(get_eval_cost(trunc_lvl, false));
+    tools_thread::parallel_for(0, n, do_batch, num_threads, grain);
+  } else {
+    do_batch(tools_batch::Batch{ 0, n });
   }
 
   // go back to original order
@@ -1355,7 +1369,8 @@ Vinecop::rosenblatt(Eigen::MatrixXd u,
                                           : hfunc2.col(inverse_order[j]);
     }
     // randomize by weighting left and right limits with independent uniforms
-    auto R = tools_stats::simulate_uniform(u.rows(), d, false, seeds);
+    auto R =
+      tools_stats::simulate_uniform(u.rows(), d, false, seeds, num_threads);
     U.leftCols(d) = U.leftCols(d).array() * R.array() +
                     U.rightCols(d).array() * (1 - R.array());
   }
@@ -1410,7 +1425,9 @@ Vinecop::inverse_rosenblatt(const Eigen::MatrixXd& u,
   size_t n = u.rows();
   size_t d = d_;
 
-  Eigen::MatrixXd U_vine = u.leftCols(d); // output matrix
+  // output matrix (filled in the batches, so that each batch touches its
+  // rows first)
+  Eigen::MatrixXd U_vine(n, d);
   //                   (direct + indirect)    (U_vine)       (info matrices)
   size_t bytes_required = (8 * 2 * n * d * d) + (8 * n * d) + (4 * 4 * d * d);
   // if the problem is too large (requires more than 1 GB memory), split
@@ -1430,7 +1447,9 @@ Vinecop::inverse_rosenblatt(const Eigen::MatrixXd& u,
   auto order = rvine_structure_.get_order();
   auto inverse_order = tools_stl::invert_permutation(order);
 
+  auto observer = ObserverScope::get_current();
   auto do_batch = [&](const tools_batch::Batch& b) {
+    ObserverTimer timer(observer.get());
     // temporary storage objects for (inverse) h-functions
     TriangularArray<Eigen::VectorXd> hinv2(d + 1, trunc_lvl + 1);
     TriangularArray<Eigen::VectorXd> hfunc1(d + 1, trunc_lvl + 1);
@@ -1477,12 +1496,18 @@ Vinecop::inverse_rosenblatt(const Eigen::MatrixXd& u,
     for (size_t j = 0; j < d; j++) {
       U_vine.block(b.begin, j, b.size, 1) = hinv2(0, inverse_order[j]);
     }
+    if (observer) {
+      observer->on_batch(
+        { "inverse_rosenblatt", b.begin, b.size, timer.get_seconds() });
+    }
   };
 
   if (trunc_lvl > 0) {
-    tools_thread::ThreadPool pool((num_threads == 1) ? 0 : num_threads);
-    pool.map(do_batch, tools_batch::create_batches(n, num_threads));
-    pool.join();
+    size_t grain =
+      tools_batch::compute_min_batch_size(get_eval_cost(trunc_lvl, true));
+    tools_thread::parallel_for(0, n, do_batch, num_threads, grain);
+  } else {
+    U_vine = u.leftCols(d);
   }
 
   set_var_types_internal(var_types);
@@ -1557,6 +1582,223 @@ Vinecop::finalize_fit(const tools_select::VinecopSelector& selector)
   loglik_ = selector.get_loglik();
   nobs_ = selector.get_nobs();
   pair_copulas_ = selector.get_pair_copulas();
+  partial_ = selector.is_cancelled();
+}
+
+//! @brief Fits the pair-copulas of the first `trunc_lvl` trees.
+//!
+//! @details A pair-copula is fitted as soon as the h-functions of its two
+//! parent edges in the previous tree are available. Trees are thus processed
+//! in a pipelined fashion instead of one after another. H-functions are
+//! released once all pair-copulas using them have been fitted.
+//!
+//! @param u Data as returned by `collapse_data()`.
+//! @param trunc_lvl The number of trees to fit.
+//! @param num_threads The number of threads to use for parallel computation.
+//! @param fit_edge A function `fit_edge(tree, edge, u_e)` that fits the
+//!   pair-copula in `pair_copulas_[tree][edge]` to the data `u_e`.
+inline void
+Vinecop::fit_pair_copulas(
+  const Eigen::MatrixXd& u,
+  size_t trunc_lvl,
+  size_t num_threads,
+  const std::function<void(size_t, size_t, const Eigen::MatrixXd&)>& fit_edge)
+{
+  auto order = rvine_structure_.get_order();
+  auto disc_cols = tools_select::get_disc_cols(var_types_);
+  size_t n = u.rows();
+
+  // h-functions by tree; level 0 holds the data (in natural order),
+  // level t + 1 the h-functions of tree t (all data must be in (0, 1))
+  std::vector<std::vector<Eigen::VectorXd>> hfunc1(trunc_lvl + 1);
+  auto hfunc2 = hfunc1, hfunc1_sub = hfunc1, hfunc2_sub = hfunc1;
+  for (size_t t = 0; t <= trunc_lvl; ++t) {
+    hfunc1[t].resize(d_ - t);
+    hfunc2[t].resize(d_ - t);
+    hfunc1_sub[t].resize(d_ - t);
+    hfunc2_sub[t].resize(d_ - t);
+  }
+  for (size_t j = 0; j < d_; ++j) {
+    hfunc2[0][j] = u.col(order[j] - 1);
+    if (var_types_[order[j] - 1] == "d") {
+      hfunc2_sub[0][j] = u.col(d_ + disc_cols[order[j] - 1]);
+    }
+  }
+
+  // edge (t, e) uses the h-functions of edges (t - 1, e) and (t - 1, m - 1)
+  std::vector<std::vector<size_t>> num_parents(trunc_lvl);
+  std::vector<std::vector<size_t>> num_readers(trunc_lvl);
+  std::vector<std::vector<std::vector<size_t>>> children(trunc_lvl);
+  for (size_t t = 0; t < trunc_lvl; ++t) {
+    num_parents[t].assign(d_ - t - 1, (t > 0) ? 2 : 0);
+    num_readers[t].assign(d_ - t, 0);
+    children[t].resize(d_ - t - 1);
+    for (size_t e = 0; e < d_ - t - 1; ++e) {
+      size_t m = rvine_structure_.min_array(t, e);
+      ++num_readers[t][e];
+      ++num_readers[t][m - 1];
+      if (t > 0) {
+        children[t - 1][e].push_back(e);
+        children[t - 1][m - 1].push_back(e);
+      }
+    }
+  }
+
+  // fits an edge and returns the edges of the next tree that became ready
+  std::mutex mtx;
+  auto process_edge = [&](size_t tree, size_t edge) {
+    tools_interface::check_user_interrupt(edge % 5 == 0);
+    // extract evaluation point from h-functions of previous tree
+    auto var_types = pair_copulas_[tree][edge].get_var_types();
+    size_t m = rvine_structure_.min_array(tree, edge);
+    bool m_is_conditioned =
+      (m == rvine_structure_.struct_array(tree, edge, true));
+
+    auto u_e = Eigen::MatrixXd(n, 2), u_e_sub = Eigen::MatrixXd(n, 2);
+    u_e.col(0) = hfunc2[tree][edge];
+    u_e.col(1) = m_is_conditioned ? hfunc2[tree][m - 1] : hfunc1[tree][m - 1];
+    if ((var_types[0] == "d") || (var_types[1] == "d")) {
+      // left limits are only stored for discrete variables
+      const auto& sub0 = hfunc2_sub[tree][edge];
+      const auto& sub1 =
+        m_is_conditioned ? hfunc2_sub[tree][m - 1] : hfunc1_sub[tree][m - 1];
+      u_e.conservativeResize(n, 4);
+      u_e.col(2) = (var_types[0] == "d") ? sub0 : u_e.col(0);
+      u_e.col(3) = (var_types[1] == "d") ? sub1 : u_e.col(1);
+    }
+
+    fit_edge(tree, edge, u_e);
+    const Bicop& edge_copula = pair_copulas_[tree][edge];
+
+    // h-functions are only evaluated if needed in next tree
+    Eigen::VectorXd h1, h2, h1_sub, h2_sub;
+    if (rvine_structure_.needed_hfunc1(tree, edge)) {
+      h1 = edge_copula.hfunc1(u_e);
+      if (var_types[1] == "d") {
+        u_e_sub = u_e;
+        u_e_sub.col(1) = u_e.col(3);
+        h1_sub = edge_copula.hfunc1(u_e_sub);
+      }
+    }
+    if (rvine_structure_.needed_hfunc2(tree, edge)) {
+      h2 = edge_copula.hfunc2(u_e);
+      if (var_types[0] == "d") {
+        u_e_sub = u_e;
+        u_e_sub.col(0) = u_e.col(2);
+        h2_sub = edge_copula.hfunc2(u_e_sub);
+      }
+    }
+
+    // the following block modifies thread-external variables
+    // and is thus shielded by a mutex
+    std::vector<size_t> ready;
+    std::lock_guard<std::mutex> lk(mtx);
+    hfunc1[tree + 1][edge] = std::move(h1);
+    hfunc2[tree + 1][edge] = std::move(h2);
+    hfunc1_sub[tree + 1][edge] = std::move(h1_sub);
+    hfunc2_sub[tree + 1][edge] = std::move(h2_sub);
+    for (auto j : { edge, m - 1 }) {
+      if (--num_readers[tree][j] == 0) {
+        hfunc1[tree][j] = Eigen::VectorXd();
+        hfunc2[tree][j] = Eigen::VectorXd();
+        hfunc1_sub[tree][j] = Eigen::VectorXd();
+        hfunc2_sub[tree][j] = Eigen::VectorXd();
+      }
+    }
+    if (tree + 1 < trunc_lvl) {
+      for (auto child : children[tree][edge]) {
+        if (--num_parents[tree + 1][child] == 0) {
+          ready.push_back(child);
+        }
+      }
+    }
+    return ready;
+  };
+
+  if (num_threads <= 1) {
+    for (size_t tree = 0; tree < trunc_lvl; ++tree) {
+      tools_interface::check_user_interrupt();
+      for (size_t edge = 0; edge < d_ - tree - 1; ++edge) {
+        process_edge(tree, edge);
+      }
+    }
+    return;
+  }
+
+  tools_thread::TaskGroup task_group(num_threads);
+  std::function<void(size_t, size_t)> run_edge = [&](size_t tree,
+                                                     size_t edge) {
+    for (auto child : process_edge(tree, edge)) {
+      task_group.push(run_edge, tree + 1, child);
+    }
+  };
+  for (size_t edge = 0; edge < d_ - 1; ++edge) {
+    task_group.push(run_edge, 0, edge);
+  }
+  task_group.wait();
+}
+
+//! @brief Selects the pair-copulas of the first `trunc_lvl` trees of the
+//! current structure (see `fit_pair_copulas()`).
+inline void
+Vinecop::select_pair_copulas(const Eigen::MatrixXd& u,
+                             size_t trunc_lvl,
+                             const FitControlsVinecop& controls)
+{
+  // keep current pair-copulas as starting points (see `Bicop::select()`)
+  rvine_structure_.truncate(trunc_lvl);
+  auto pair_copulas = make_pair_copula_store(d_, trunc_lvl);
+  for (size_t t = 0; t < std::min(trunc_lvl, pair_copulas_.size()); ++t) {
+    pair_copulas[t] = pair_copulas_[t];
+  }
+  pair_copulas_ = pair_copulas;
+  set_var_types_internal(var_types_);
+
+  // all threads are used for the edges, not within Bicop::select()
+  std::vector<FitControlsBicop> tree_controls(trunc_lvl, controls);
+  for (size_t t = 0; t < trunc_lvl; ++t) {
+    tree_controls[t].set_num_threads(1);
+    if (controls.get_selection_criterion() == "mbicv") {
+      // adjust prior probability to tree level
+      tree_controls[t].set_psi0(std::pow(controls.get_psi0(), t + 1));
+    }
+  }
+
+  auto observer = controls.get_observer();
+  auto select_edge = [&](size_t tree, size_t edge, const Eigen::MatrixXd& u_e) {
+    Bicop& pc = pair_copulas_[tree][edge];
+    ObserverTimer timer(observer.get());
+    double crit = 1.0;
+    if (controls.get_threshold() > 0) {
+      crit = tools_select::calculate_criterion(u_e.leftCols(2),
+                                               controls.get_tree_criterion(),
+                                               controls.get_weights());
+    }
+    if (crit < controls.get_threshold()) {
+      auto var_types = pc.get_var_types();
+      pc = Bicop();
+      pc.set_var_types(var_types);
+    } else {
+      pc.select(u_e, tree_controls[tree]);
+    }
+    if (observer) {
+      observer->on_edge({ tree,
+                          edge,
+                          pc.get_family(),
+                          pc.get_rotation(),
+                          pc.get_num_objective_calls(),
+                          timer.get_seconds() });
+    }
+  };
+  fit_pair_copulas(u, trunc_lvl, controls.get_num_threads(), select_edge);
+
+  threshold_ = controls.get_threshold();
+  loglik_ = 0, nobs_ = u.rows();
+  for (size_t tree = 0; tree < trunc_lvl; ++tree) {
+    for (size_t edge = 0; edge < d_ - tree - 1; ++edge) {
+      loglik_ += pair_copulas_[tree][edge].get_loglik();
+    }
+  }
 }
 
 //! Checks if weights are compatible with the data.
@@ -1653,6 +1895,52 @@ Vinecop::is_discrete() const
   return get_n_discrete() > 0;
 }
 
+//! @brief Estimates the cost of evaluating the first `trunc_lvl` trees of the
+//! model at a single point.
+//!
+//! @details The cost is measured in units of the cost of evaluating the
+//! density of a Gaussian pair-copula at a single point (see
+//! `tools_batch::min_batch_cost`) and is used to choose batch sizes for
+//! parallel evaluation.
+//! @param trunc_lvl The number of trees to evaluate.
+//! @param inverse Whether inverse h-functions are evaluated.
+inline double
+Vinecop::get_eval_cost(size_t trunc_lvl, bool inverse) const
+{
+  auto get_edge_cost = [inverse](BicopFamily family) -> double {
+    switch (family) {
+      case BicopFamily::indep:
+        return 0.1;
+      case BicopFamily::gaussian:
+      case BicopFamily::clayton:
+        return 1.0;
+      case BicopFamily::student:
+        return 3.0;
+      case BicopFamily::gumbel:
+      case BicopFamily::joe:
+        // inverse h-functions are computed by Newton's method
+        return inverse ? 10.0 : 2.0;
+      case BicopFamily::tll:
+        // pdf and h-functions are interpolated on a grid
+        return inverse ? 35.0 : 1.0;
+      default:
+        // inverse h-functions are computed by bisection
+        return inverse ? 70.0 : 2.0;
+    }
+  };
+
+  double cost = 0.0;
+  trunc_lvl = std::min(trunc_lvl, pair_copulas_.size());
+  for (size_t t = 0; t < trunc_lvl; ++t) {
+    for (const auto& pc : pair_copulas_[t]) {
+      cost += get_edge_cost(pc.get_family());
+    }
+  }
+
+  // discrete variables require additional evaluations for the left limits
+  return is_discrete() ? 2 * cost : cost;
+}
+
 //! @brief Removes superfluous columns for continuous data.
 inline Eigen::MatrixXd
 Vinecop::collapse_data(const Eigen::MatrixXd& u) const
@@ -320,6 +320,11 @@ FitControlsVinecop::get_fit_controls_bicop() const
                                   get_weights(),
                                   get_psi0(),
                                   get_preselect_families());
+  controls_bicop.set_warm_start(get_warm_start());
+  controls_bicop.set_warm_start_neighbors(get_warm_start_neighbors());
+  controls_bicop.set_pruning_margin(get_pruning_margin());
+  controls_bicop.set_cancellation_token(get_cancellation_token());
+  controls_bicop.set_observer(get_observer());
   return controls_bicop;
 }
 
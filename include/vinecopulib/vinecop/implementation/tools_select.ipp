@@ -4,13 +4,17 @@
 // the MIT license. For a copy, see the LICENSE file in the root directory of
 // vinecopulib or https://vinecopulib.github.io/vinecopulib/.
 
+#include <vinecopulib/bicop/tools_select.hpp>
+#include <vinecopulib/misc/tools_eigen.hpp>
 #include <vinecopulib/misc/tools_stats.hpp>
 #include <vinecopulib/misc/tools_stl.hpp>
 
 #include <boost/graph/kruskal_min_spanning_tree.hpp>
 #include <boost/graph/prim_minimum_spanning_tree.hpp>
+#include <array>
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <wdm/eigen.hpp>
 
 namespace vinecopulib {
@@ -62,6 +66,15 @@ calculate_criterion_matrix(const Eigen::MatrixXd& data,
 {
   size_t n = data.rows();
   size_t d = data.cols();
+  if ((tree_criterion == "mcor") && (n > 10) && !data.hasNaN()) {
+    // the columns are sorted only once
+    Eigen::MatrixXd mat = tools_stats::mcor_matrix(data, weights);
+    mat = mat.unaryExpr(
+      [](double w) { return std::isnan(w) ? 0.0 : std::fabs(w); });
+    mat.diagonal() = Eigen::VectorXd::Constant(d, 1.0);
+    return mat;
+  }
+
   Eigen::MatrixXd mat(d, d);
   mat.diagonal() = Eigen::VectorXd::Constant(d, 1.0);
   Eigen::MatrixXd pair_data(n, 2);
@@ -101,7 +114,7 @@ inline VinecopSelector::VinecopSelector(const Eigen::MatrixXd& data,
   , d_(var_types.size())
   , var_types_(var_types)
   , controls_(controls)
-  , pool_(controls_.get_num_threads())
+  , task_group_(controls_.get_num_threads())
   , trees_(std::vector<VineTree>(1))
   , threshold_(controls.get_threshold())
   , psi0_(controls.get_psi0())
@@ -152,13 +165,34 @@ VinecopSelector::make_pair_copula_store(size_t d, size_t trunc_lvl)
   return pc_store;
 }
 
+//! @brief Sets the pair copulas of a previous model that are used as starting
+//! points for trees with known structure.
+//! @param pair_copulas A nested vector such that `pair_copulas[t][e]`
+//!     corresponds to tree `t` and edge `e` of the known structure.
+inline void
+VinecopSelector::set_warm_start_pair_copulas(
+  const std::vector<std::vector<Bicop>>& pair_copulas)
+{
+  warm_start_pcs_ = pair_copulas;
+}
+
 inline void
 VinecopSelector::select_all_trees(const Eigen::MatrixXd& data)
 {
   loglik_ = 0.0;
   initialize_new_fit(data);
   for (size_t t = 0; t < d_ - 1; ++t) {
-    select_tree(t); // select pair copulas (+ structure) of tree t
+    try {
+      select_tree(t); // select pair copulas (+ structure) of tree t
+    } catch (const CancelledException&) {
+      if (t == 0) {
+        throw; // no model to fall back to
+      }
+      // keep the trees that were selected before
+      cancelled_ = true;
+      controls_.set_trunc_lvl(t);
+      break;
+    }
     loglik_ += get_loglik_of_tree(t);
 
     if (controls_.get_show_trace()) {
@@ -172,6 +206,8 @@ VinecopSelector::select_all_trees(const Eigen::MatrixXd& data)
       break;
     }
   }
+  // the model must be finalized even if the computation was cancelled
+  CancellationScope cancellation_scope(std::make_shared<CancellationToken>());
   finalize(controls_.get_trunc_lvl());
 }
 
@@ -190,6 +226,11 @@ VinecopSelector::sparse_select_all_trees(const Eigen::MatrixXd& data)
     // truncated the model
     controls_.set_family_set(family_set);
     controls_.set_trunc_lvl(std::numeric_limits<size_t>::max());
+    // keep trees of the previous iteration for re-use
+    std::swap(trees_, old_trees_);
+    trees_.resize(1);
+    allowed_edges_.resize(
+      std::min(allowed_edges_.size(), old_trees_.size() - 1));
     initialize_new_fit(data);
 
     // decrease the threshold
@@ -218,7 +259,21 @@ VinecopSelector::sparse_select_all_trees(const Eigen::MatrixXd& data)
       }
 
       // select pair copulas (and possibly tree structure)
-      select_tree(t);
+      try {
+        select_tree(t);
+      } catch (const CancelledException&) {
+        // fall back to the optimal model of the previous iterations or, if
+        // there is none, the trees that were selected before
+        if (trees_opt_.empty()) {
+          if (t == 0) {
+            throw; // no model to fall back to
+          }
+          controls_.set_trunc_lvl(t);
+          set_current_fit_as_opt(loglik);
+        }
+        cancelled_ = true;
+        break;
+      }
       num_changed += d - 1 - static_cast<double>(t);
 
       // update fit statistic
@@ -255,8 +310,8 @@ VinecopSelector::sparse_select_all_trees(const Eigen::MatrixXd& data)
             mbicv_trunc -= mbicv_tree;
             t--;
           }
-          set_current_fit_as_opt(loglik);
           controls_.set_trunc_lvl(t);
+          set_current_fit_as_opt(loglik);
           if (!select_threshold) {
             // fixed threshold, no need to continue
             needs_break = true;
@@ -267,6 +322,10 @@ VinecopSelector::sparse_select_all_trees(const Eigen::MatrixXd& data)
       }
     }
 
+    if (cancelled_) {
+      break;
+    }
+
     if (controls_.get_show_trace()) {
       std::cout << "--> mbicv = " << mbicv << ", loglik = " << loglik
                 << std::endl
@@ -298,7 +357,15 @@ VinecopSelector::sparse_select_all_trees(const Eigen::MatrixXd& data)
   }
 
   // set final model
+  fit_cache_.clear();
+  allowed_edges_.clear();
+  old_trees_.clear();
   trees_ = trees_opt_;
+  if (cancelled_) {
+    controls_.set_trunc_lvl(trunc_lvl_opt_);
+  }
+  // the model must be finalized even if the computation was cancelled
+  CancellationScope cancellation_scope(std::make_shared<CancellationToken>());
   finalize(controls_.get_trunc_lvl());
 }
 
@@ -332,6 +399,14 @@ VinecopSelector::get_nobs() const
   return n_;
 }
 
+// whether selection was cancelled (the model then only contains the trees
+// selected before)
+inline bool
+VinecopSelector::is_cancelled() const
+{
+  return cancelled_;
+}
+
 //! chooses threshold for next iteration such that at a proportion of at
 //! least 2.5% of the previously thresholded pairs become non-thresholded.
 inline double
@@ -362,7 +437,11 @@ inline void
 VinecopSelector::add_allowed_edges(VineTree& vine_tree)
 {
   std::string tree_criterion = controls_.get_tree_criterion();
-  if (structure_known_) {
+  if (tree_criterion == "tau") {
+    add_allowed_edges_ktau(vine_tree);
+  } else if (structure_known_ && (tree_criterion == "mcor")) {
+    add_allowed_edges_mcor(vine_tree);
+  } else if (structure_known_) {
     double threshold = controls_.get_threshold();
     std::mutex m;
     auto add_edge = [&](size_t v0) {
@@ -385,8 +464,8 @@ VinecopSelector::add_allowed_edges(VineTree& vine_tree)
       }
     };
 
-    pool_.map(add_edge, boost::vertices(vine_tree));
-    pool_.wait();
+    task_group_.map(add_edge, boost::vertices(vine_tree));
+    task_group_.wait();
   } else {
     size_t tree = d_ - boost::num_vertices(vine_tree);
     size_t edges = boost::num_vertices(vine_tree) - 1;
@@ -404,6 +483,194 @@ VinecopSelector::add_allowed_edges(VineTree& vine_tree)
       }
     }
   }
+
+  if (controls_.needs_sparse_select()) {
+    // keep the criteria for the next iteration
+    size_t t = d_ - boost::num_vertices(vine_tree);
+    allowed_edges_.resize(t + 1);
+    for (auto e : boost::edges(vine_tree)) {
+      allowed_edges_[t].push_back(std::make_tuple(boost::source(e, vine_tree),
+                                                  boost::target(e, vine_tree),
+                                                  vine_tree[e].crit,
+                                                  vine_tree[e].tau));
+    }
+  }
+}
+
+//! @brief Adds the edges of a tree for `tree_criterion = "tau"`.
+//!
+//! These are all edges allowed by the proximity condition or, if the
+//! structure is fixed, the edges of the structure. The pairs' data are
+//! arranged next to each other in blocks and Kendall's \f$ \tau \f$ of a
+//! whole block is computed at once (see `tools_stats::ktau_pairs()`); the
+//! criteria are the same as those of `calculate_criterion()`. The signed
+//! \f$ \tau \f$ is kept in the edges for the family selection.
+//! @param vine_tree Tree of a vine.
+inline void
+VinecopSelector::add_allowed_edges_ktau(VineTree& vine_tree)
+{
+  std::vector<std::pair<size_t, size_t>> pairs;
+  if (structure_known_) {
+    for (size_t v0 = 0; v0 < boost::num_vertices(vine_tree); ++v0) {
+      tools_interface::check_user_interrupt(v0 % 50 == 0);
+      for (size_t v1 = 0; v1 < v0; ++v1) {
+        // check proximity condition: common neighbor in previous tree
+        // (-1 means 'no common neighbor')
+        if (find_common_neighbor(v0, v1, vine_tree) > -1) {
+          pairs.push_back(std::make_pair(v0, v1));
+        }
+      }
+    }
+  } else {
+    size_t tree = d_ - boost::num_vertices(vine_tree);
+    if (tree < vine_struct_.get_trunc_lvl()) {
+      for (size_t v0 = 0; v0 < boost::num_vertices(vine_tree) - 1; ++v0) {
+        pairs.push_back(
+          std::make_pair(v0, vine_struct_.min_array(tree, v0) - 1));
+      }
+    }
+  }
+
+  // blocks of up to 32 MB of data
+  size_t block_size = std::max(
+    static_cast<size_t>(1), std::min(pairs.size(), (1 << 21) / (n_ + 1)));
+  Eigen::MatrixXd block(n_, 2 * block_size);
+  double threshold = controls_.get_threshold();
+  for (size_t b = 0; b < pairs.size(); b += block_size) {
+    tools_interface::check_user_interrupt();
+    size_t m = std::min(block_size, pairs.size() - b);
+    for (size_t k = 0; k < m; ++k) {
+      block.middleCols(2 * k, 2) =
+        get_pc_data(pairs[b + k].first, pairs[b + k].second, vine_tree);
+    }
+    Eigen::VectorXd tau = tools_stats::ktau_pairs(block.leftCols(2 * m),
+                                                  controls_.get_weights(),
+                                                  controls_.get_num_threads());
+    for (size_t k = 0; k < m; ++k) {
+      auto pc_data = block.middleCols(2 * k, 2);
+      double n_complete = static_cast<double>(
+        (!pc_data.array().isNaN().rowwise().any()).count());
+      double crit = 0.0;
+      if ((n_complete > 10) && !std::isnan(tau(k))) {
+        crit = std::fabs(tau(k)) *
+               std::sqrt(n_complete / static_cast<double>(n_));
+      }
+      double w = 1.0;
+      if (structure_known_) {
+        w -= static_cast<double>(crit >= threshold) * crit;
+      }
+      auto e =
+        boost::add_edge(pairs[b + k].first, pairs[b + k].second, w, vine_tree)
+          .first;
+      vine_tree[e].weight = w;
+      vine_tree[e].crit = crit;
+      vine_tree[e].tau = tau(k);
+    }
+  }
+}
+
+//! @brief Adds all edges allowed by the proximity condition for
+//! `tree_criterion = "mcor"`.
+//!
+//! The criterion only depends on the data through their orders and each
+//! vertex contributes one of its two h-functions to a pair, so the
+//! h-functions are sorted once instead of once per pair (see
+//! `tools_stats::pairwise_mcor()`). Pairs with missing values are handled by
+//! `calculate_criterion()`.
+//! @param vine_tree Tree of a vine.
+inline void
+VinecopSelector::add_allowed_edges_mcor(VineTree& vine_tree)
+{
+  // the h-function of vertex v used in a pair is stored at 2 * v (hfunc1)
+  // or 2 * v + 1 (hfunc2)
+  size_t num_vertices = boost::num_vertices(vine_tree);
+  std::vector<std::array<size_t, 4>> pairs; // v0, v1, h-function indices
+  std::vector<bool> is_used(2 * num_vertices, false);
+  for (size_t v0 = 0; v0 < num_vertices; ++v0) {
+    tools_interface::check_user_interrupt(v0 % 50 == 0);
+    for (size_t v1 = 0; v1 < v0; ++v1) {
+      // check proximity condition: common neighbor in previous tree
+      // (-1 means 'no common neighbor')
+      ptrdiff_t ei_common = find_common_neighbor(v0, v1, vine_tree);
+      if (ei_common > -1) {
+        size_t pos0 = find_position(static_cast<size_t>(ei_common),
+                                    vine_tree[v0].prev_edge_indices);
+        size_t pos1 = find_position(static_cast<size_t>(ei_common),
+                                    vine_tree[v1].prev_edge_indices);
+        size_t h0 = 2 * v0 + static_cast<size_t>(pos0 != 0);
+        size_t h1 = 2 * v1 + static_cast<size_t>(pos1 != 0);
+        pairs.push_back({ { v0, v1, h0, h1 } });
+        is_used[h0] = true;
+        is_used[h1] = true;
+      }
+    }
+  }
+
+  size_t num_threads = controls_.get_num_threads();
+  std::vector<std::vector<size_t>> orders(2 * num_vertices);
+  std::vector<bool> has_nan(2 * num_vertices, false);
+  for (size_t h = 0; h < 2 * num_vertices; ++h) {
+    if (is_used[h]) {
+      Eigen::VectorXd x = get_hfunc(vine_tree[h / 2], h % 2 == 0);
+      has_nan[h] = x.hasNaN();
+      if (!has_nan[h]) {
+        orders[h] =
+          tools_stl::get_order(std::vector<double>(x.data(), x.data() + n_));
+      }
+    }
+  }
+
+  std::string tree_criterion = controls_.get_tree_criterion();
+  Eigen::VectorXd weights = controls_.get_weights();
+  std::vector<double> crits(pairs.size(), 0.0);
+  auto do_batch = [&](const tools_batch::Batch& b) {
+    for (size_t k = b.begin; k < b.begin + b.size; ++k) {
+      const auto& p = pairs[k];
+      if (has_nan[p[2]] || has_nan[p[3]]) {
+        crits[k] = calculate_criterion(
+          get_pc_data(p[0], p[1], vine_tree), tree_criterion, weights);
+      } else if (n_ > 10) {
+        double w =
+          tools_stats::pairwise_mcor(orders[p[2]], orders[p[3]], weights);
+        crits[k] = std::isnan(w) ? 0.0 : std::fabs(w);
+      }
+    }
+  };
+  tools_thread::parallel_for(0, pairs.size(), do_batch, num_threads, 1);
+
+  double threshold = controls_.get_threshold();
+  for (size_t k = 0; k < pairs.size(); ++k) {
+    double crit = crits[k];
+    double w = 1.0 - static_cast<double>(crit >= threshold) * crit;
+    auto e = boost::add_edge(pairs[k][0], pairs[k][1], w, vine_tree).first;
+    vine_tree[e].weight = w;
+    vine_tree[e].crit = crit;
+  }
+}
+
+//! @brief Adds the allowed edges found in a previous iteration of a sparse
+//! selection.
+//!
+//! The data haven't changed since, so only the edge weights need to be
+//! updated for the current threshold.
+//! @param vine_tree Tree of a vine.
+//! @param t The tree level.
+inline void
+VinecopSelector::add_old_allowed_edges(VineTree& vine_tree, size_t t)
+{
+  double threshold = controls_.get_threshold();
+  for (const auto& edge : allowed_edges_[t]) {
+    double crit = std::get<2>(edge);
+    double w = 1.0;
+    if (structure_known_) {
+      w -= static_cast<double>(crit >= threshold) * crit;
+    }
+    auto e =
+      boost::add_edge(std::get<0>(edge), std::get<1>(edge), w, vine_tree).first;
+    vine_tree[e].weight = w;
+    vine_tree[e].crit = crit;
+    vine_tree[e].tau = std::get<3>(edge);
+  }
 }
 
 //! @brief Selects the edges using the minimum spanning tree.
@@ -637,14 +904,22 @@ VinecopSelector::get_pc_data(size_t v0, size_t v1, const VineTree& tree)
 //!        observations.
 //!     5. Fit and select a copula model for each edge.
 //!
-//! @param prev_tree Tree T_{k}.
-//! @param controls The controls for fitting a vine copula
-//!     (see FitControlsVinecop).
-//! @param tree_opt The current optimal tree (used only for sparse
-//!     selection).
+//! During a sparse selection, a tree whose data haven't changed since the
+//! previous iteration re-uses the allowed edges and criteria computed in step
+//! 2 and the pair-copulas fitted in step 5 (see `add_old_allowed_edges()` and
+//! `select_pair_copulas()`). If the selected tree is the same as in the
+//! previous iteration, the data of the next tree haven't changed either.
+//!
+//! @param t The tree level.
 inline void
 VinecopSelector::select_tree(size_t t)
 {
+  auto observer = controls_.get_observer();
+  ObserverTimer tree_timer(observer.get());
+  if (observer) {
+    observer->on_tree_start(t);
+  }
+
   auto new_tree = edges_as_vertices(trees_[t]);
   remove_edge_data(trees_[t]); // no longer needed
 
@@ -652,9 +927,24 @@ VinecopSelector::select_tree(size_t t)
     // only important if proximity_ was previously false (partial selection)
     structure_known_ = true;
   }
-  add_allowed_edges(new_tree);
+  // data of the tree are the same as in the previous iteration
+  bool has_same_data = (t < allowed_edges_.size());
+  ObserverTimer timer(observer.get());
+  if (has_same_data) {
+    add_old_allowed_edges(new_tree, t);
+  } else {
+    add_allowed_edges(new_tree);
+  }
+  if (observer) {
+    observer->on_edges_scored(
+      t, boost::num_edges(new_tree), timer.get_seconds());
+  }
   if (boost::num_vertices(new_tree) > 2) {
+    ObserverTimer mst_timer(observer.get());
     select_edges(new_tree);
+    if (observer) {
+      observer->on_mst(t, boost::num_edges(new_tree), mst_timer.get_seconds());
+    }
   }
   if (boost::num_vertices(new_tree) > 0) {
     add_edge_info(new_tree);      // for pc estimation and next tree
@@ -663,15 +953,19 @@ VinecopSelector::select_tree(size_t t)
       // adjust prior probability to tree level
       controls_.set_psi0(std::pow(psi0_, t + 1));
     }
-    if (trees_opt_.size() > t + 1) {
-      select_pair_copulas(new_tree, trees_opt_[t + 1]);
-    } else {
-      select_pair_copulas(new_tree);
-    }
+    select_pair_copulas(new_tree);
+  }
+  if (!has_same_data || !is_same_tree(new_tree, old_trees_[t + 1])) {
+    // data of higher trees have changed
+    allowed_edges_.resize(std::min(allowed_edges_.size(), t + 1));
   }
   // make sure there is space for new tree
   trees_.resize(t + 2);
   trees_[t + 1] = new_tree;
+
+  if (observer) {
+    observer->on_tree_finish(t, tree_timer.get_seconds());
+  }
 }
 
 inline double
@@ -768,6 +1062,7 @@ VinecopSelector::set_current_fit_as_opt(const double& loglik)
 {
   threshold_ = controls_.get_threshold();
   trees_opt_ = trees_;
+  trunc_lvl_opt_ = std::min(controls_.get_trunc_lvl(), trees_.size() - 1);
   loglik_ = loglik;
 }
 
@@ -870,20 +1165,48 @@ VinecopSelector::find_common_neighbor(size_t v0,
   }
 }
 
-//! @brief Computes a fit id; can be used to re-use already fitted pair-copulas.
-//! @param edge.
-inline double
-VinecopSelector::compute_fit_id(const EdgeProperties& e)
+//! @brief Computes a fit key; can be used to re-use already fitted
+//! pair-copulas.
+//! @param e The properties of an edge preprocessed with `add_pc_info()`.
+inline FitKey
+VinecopSelector::compute_fit_key(const EdgeProperties& e)
 {
-  double id = 0.0;
-  if (controls_.needs_sparse_select()) {
-    // the formula is quite arbitrary, but sufficient for
-    // identifying situations where fits can be re-used
-    id = (e.pc_data.col(0) - 2 * e.pc_data.col(1)).sum();
-    id += 5.0 * static_cast<double>(e.crit < controls_.get_threshold());
-  }
+  FitKey key;
+  key.conditioned = e.conditioned;
+  key.conditioning = e.conditioning;
+  std::sort(key.conditioning.begin(), key.conditioning.end());
+  key.data_hash =
+    boost::hash_range(e.pc_data.data(), e.pc_data.data() + e.pc_data.size());
+  return key;
+}
 
-  return id;
+//! @brief Checks whether two trees have the same edges and pair-copulas.
+//! @param tree A vine tree.
+//! @param old_tree A vine tree from a previous iteration.
+inline bool
+VinecopSelector::is_same_tree(const VineTree& tree, const VineTree& old_tree)
+{
+  if (boost::num_edges(tree) != boost::num_edges(old_tree)) {
+    return false;
+  }
+  auto old_edges = boost::edges(old_tree);
+  auto old_e = old_edges.first;
+  for (auto e : boost::edges(tree)) {
+    if ((boost::source(e, tree) != boost::source(*old_e, old_tree)) ||
+        (boost::target(e, tree) != boost::target(*old_e, old_tree))) {
+      return false;
+    }
+    const auto& pc = tree[e].pair_copula;
+    const auto& old_pc = old_tree[*old_e].pair_copula;
+    if ((pc.get_family() != old_pc.get_family()) ||
+        (pc.get_rotation() != old_pc.get_rotation()) ||
+        (pc.get_parameters().size() != old_pc.get_parameters().size()) ||
+        (pc.get_parameters() != old_pc.get_parameters())) {
+      return false;
+    }
+    ++old_e;
+  }
+  return true;
 }
 
 //! @brief Collapses a graph to the minimum spanning tree.
@@ -965,35 +1288,104 @@ VinecopSelector::remove_vertex_data(VineTree& tree)
 }
 
 //! @brief Fits and selects a pair copula for each edges.
+//!
+//! @details The candidate fits of all edges are pushed to the thread pool as
+//! independent tasks, so that threads are kept busy irrespective of the
+//! number of edges in the tree. During a sparse selection, fits from
+//! previous iterations are re-used whenever the edge's data haven't changed.
 //! @param tree A vine tree preprocessed with `add_edge_info()`.
-//! @param tree_opt The current optimal tree (used only for sparse
-//!     selection).
 inline void
-VinecopSelector::select_pair_copulas(VineTree& tree, const VineTree& tree_opt)
+VinecopSelector::select_pair_copulas(VineTree& tree)
 {
-  auto select_pc = [&](EdgeIterator e) -> void {
+  bool use_cache = controls_.needs_sparse_select();
+  std::vector<EdgeIterator> edges;
+  for (auto e : boost::edges(tree)) {
+    edges.push_back(e);
+  }
+  std::vector<size_t> edge_indices = tools_stl::seq_int(0, edges.size());
+
+  // set up a family selection for all edges that need one
+  std::vector<std::unique_ptr<BicopSelector>> selectors(edges.size());
+  auto prepare_pc = [&](size_t i) -> void {
     tools_interface::check_user_interrupt();
+    auto e = edges[i];
     bool is_thresholded = (tree[e].crit < controls_.get_threshold());
     bool used_old_fit = false;
 
-    tree[e].fit_id = compute_fit_id(tree[e]);
-    if (boost::num_edges(tree_opt) > 0) {
-      auto old_fit = find_old_fit(tree[e].fit_id, tree_opt);
-      if (old_fit.second) { // indicates if match was found
-        // data and thresholding status haven't changed,
-        // we can use old fit
+    if (use_cache && !is_thresholded) {
+      tree[e].fit_key = compute_fit_key(tree[e]);
+      auto old_fit = fit_cache_.find(tree[e].fit_key);
+      if (old_fit != fit_cache_.end()) {
+        // data haven't changed, we can use old fit
         used_old_fit = true;
-        tree[e].pair_copula = tree_opt[old_fit.first].pair_copula;
+        tree[e].pair_copula = old_fit->second;
       }
     }
 
     if (!used_old_fit) {
       tree[e].pair_copula = vinecopulib::Bicop();
+      if (!is_thresholded) {
+        // in trees with known structure, the edge index is the source vertex
+        size_t t = d_ - boost::num_vertices(tree);
+        size_t edge = boost::source(e, tree);
+        if ((t < warm_start_pcs_.size()) &&
+            (edge < warm_start_pcs_[t].size())) {
+          tree[e].pair_copula = warm_start_pcs_[t][edge];
+        }
+      }
       tree[e].pair_copula.set_var_types(tree[e].var_types);
       if (!is_thresholded) {
-        tree[e].pair_copula.select(tree[e].pc_data, controls_);
+        // Kendall's tau of the criterion is re-used if the family selection
+        // omits the same rows
+        double tau = tree[e].tau;
+        if ((tree[e].pc_data.cols() > 2) && tree[e].pc_data.hasNaN()) {
+          tau = std::numeric_limits<double>::quiet_NaN();
+        }
+        selectors[i].reset(new BicopSelector(
+          tree[e].pair_copula, tree[e].pc_data, controls_, tau));
+      }
+    }
+  };
+  task_group_.map(prepare_pc, edge_indices);
+  task_group_.wait();
+
+  // all (edge, candidate) pairs of the tree form one pool of tasks
+  auto get_tasks = [&] {
+    std::vector<std::pair<size_t, size_t>> tasks;
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (selectors[i]) {
+        for (size_t j = 0; j < selectors[i]->get_num_candidates(); ++j) {
+          tasks.push_back(std::make_pair(i, j));
+        }
       }
     }
+    return tasks;
+  };
+  if (std::isfinite(controls_.get_pruning_margin()) &&
+      (controls_.get_parametric_method() == "mle")) {
+    auto score_candidate = [&](std::pair<size_t, size_t> task) {
+      selectors[task.first]->score_candidate(task.second);
+    };
+    task_group_.map(score_candidate, get_tasks());
+    task_group_.wait();
+    for (auto& selector : selectors) {
+      if (selector) {
+        selector->prune_candidates();
+      }
+    }
+  }
+  auto fit_candidate = [&](std::pair<size_t, size_t> task) {
+    selectors[task.first]->fit_candidate(task.second);
+  };
+  task_group_.map(fit_candidate, get_tasks());
+  task_group_.wait();
+
+  auto finalize_pc = [&](size_t i) -> void {
+    tools_interface::check_user_interrupt();
+    auto e = edges[i];
+    if (selectors[i]) {
+      tree[e].pair_copula = selectors[i]->get_selected();
+    }
 
     tree[e].hfunc1 = tree[e].pair_copula.hfunc1(tree[e].pc_data);
     tree[e].hfunc2 = tree[e].pair_copula.hfunc2(tree[e].pc_data);
@@ -1008,28 +1400,29 @@ VinecopSelector::select_pair_copulas(VineTree& tree, const VineTree& tree_opt)
       tree[e].hfunc2_sub = tree[e].pair_copula.hfunc2(sub_data);
     }
   };
+  task_group_.map(finalize_pc, edge_indices);
+  task_group_.wait();
+
+  if (auto observer = controls_.get_observer()) {
+    size_t t = d_ - boost::num_vertices(tree);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      const auto& pc = tree[edges[i]].pair_copula;
+      EdgeEvent event{ t, i, pc.get_family(), pc.get_rotation(), 0, 0.0 };
+      if (selectors[i]) {
+        event.objective_calls = selectors[i]->get_num_objective_calls();
+        event.seconds = selectors[i]->get_fit_seconds();
+      }
+      observer->on_edge(event);
+    }
+  }
 
-  // make sure that Bicop.select() doesn't spawn too many new threads
-  size_t num_threads = controls_.get_num_threads();
-  controls_.set_num_threads(num_threads / boost::num_edges(tree));
-  pool_.map(select_pc, boost::edges(tree));
-  pool_.wait();
-  controls_.set_num_threads(num_threads);
-}
-
-//! @brief Finds the fitted pair-copula from the previous iteration.
-inline FoundEdge
-VinecopSelector::find_old_fit(double fit_id, const VineTree& old_graph)
-{
-  auto edge = boost::edge(0, 1, old_graph).first;
-  bool fit_with_same_id = false;
-  for (auto e : boost::edges(old_graph)) {
-    if (fit_id == old_graph[e].fit_id) {
-      fit_with_same_id = true;
-      edge = e;
+  if (use_cache) {
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (selectors[i]) {
+        fit_cache_.emplace(tree[edges[i]].fit_key, tree[edges[i]].pair_copula);
+      }
     }
   }
-  return std::make_pair(edge, fit_with_same_id);
 }
 
 //! @brief Gets edge index for the vine (like 1, 2; 3).
@@ -6,7 +6,11 @@
 
 #pragma once
 
+#include <boost/functional/hash.hpp>
 #include <boost/graph/adjacency_list.hpp>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
 #include <vinecopulib/bicop/class.hpp>
 #include <vinecopulib/misc/tools_interface.hpp>
 #include <vinecopulib/vinecop/fit_controls.hpp>
@@ -45,6 +49,32 @@ calculate_criterion_matrix(const Eigen::MatrixXd& data,
 std::vector<size_t>
 get_disc_cols(std::vector<std::string> var_types);
 
+// identifies a pair-copula fit by the edge's conditioned/conditioning sets and
+// a fingerprint of its data
+struct FitKey
+{
+  std::vector<size_t> conditioned;
+  std::vector<size_t> conditioning;
+  size_t data_hash;
+
+  bool operator==(const FitKey& other) const
+  {
+    return (data_hash == other.data_hash) &&
+           (conditioned == other.conditioned) &&
+           (conditioning == other.conditioning);
+  }
+};
+struct FitKeyHash
+{
+  size_t operator()(const FitKey& key) const
+  {
+    size_t seed = key.data_hash;
+    boost::hash_combine(seed, key.conditioned);
+    boost::hash_combine(seed, key.conditioning);
+    return seed;
+  }
+};
+
 // boost::graph represenation of a vine tree
 struct VertexProperties
 {
@@ -71,8 +101,10 @@ struct EdgeProperties
   std::vector<std::string> var_types{ "c", "c" };
   double weight;
   double crit;
+  // Kendall's tau of the pair if computed for the criterion (NaN otherwise)
+  double tau{ std::numeric_limits<double>::quiet_NaN() };
   vinecopulib::Bicop pair_copula;
-  double fit_id;
+  FitKey fit_key;
 };
 typedef boost::adjacency_list<
   boost::vecS,
@@ -83,7 +115,6 @@ typedef boost::adjacency_list<
   VineTree;
 
 typedef boost::graph_traits<VineTree>::edge_descriptor EdgeIterator;
-typedef std::pair<EdgeIterator, bool> FoundEdge;
 
 class VinecopSelector
 {
@@ -111,12 +142,17 @@ public:
 
   void sparse_select_all_trees(const Eigen::MatrixXd& data);
 
+  void set_warm_start_pair_copulas(
+    const std::vector<std::vector<Bicop>>& pair_copulas);
+
   double get_loglik() const;
 
   double get_threshold() const;
 
   size_t get_nobs() const;
 
+  bool is_cancelled() const;
+
   std::vector<VineTree> get_trees() const { return trees_; };
   std::vector<VineTree> get_trees_opt() const { return trees_opt_; };
 
@@ -143,6 +179,12 @@ protected:
 
   void add_allowed_edges(VineTree& vine_tree);
 
+  void add_allowed_edges_ktau(VineTree& vine_tree);
+
+  void add_allowed_edges_mcor(VineTree& vine_tree);
+
+  void add_old_allowed_edges(VineTree& vine_tree, size_t t);
+
   void select_edges(VineTree& vine_tree);
 
   Eigen::MatrixXd get_pc_data(size_t v0, size_t v1, const VineTree& tree);
@@ -154,22 +196,36 @@ protected:
 
   ptrdiff_t find_common_neighbor(size_t v0, size_t v1, const VineTree& tree);
 
-  virtual double compute_fit_id(const EdgeProperties& e);
+  FitKey compute_fit_key(const EdgeProperties& e);
+
+  bool is_same_tree(const VineTree& tree, const VineTree& old_tree);
 
   size_t n_;
   size_t d_;
   bool structure_known_{ true };
   std::vector<std::string> var_types_;
   FitControlsVinecop controls_;
-  tools_thread::ThreadPool pool_;
+  tools_thread::TaskGroup task_group_;
   std::vector<VineTree> trees_;
   RVineStructure vine_struct_;
   std::vector<std::vector<Bicop>> pair_copulas_;
+  // previous model for warm starts (only for trees with known structure)
+  std::vector<std::vector<Bicop>> warm_start_pcs_;
   // for sparse selction
   std::vector<VineTree> trees_opt_;
+  size_t trunc_lvl_opt_{ 0 };
+  // fits of previous threshold iterations
+  std::unordered_map<FitKey, Bicop, FitKeyHash> fit_cache_;
+  // trees of the previous iteration and allowed edges (v0, v1, crit, tau)
+  // of those whose data haven't changed
+  std::vector<VineTree> old_trees_;
+  std::vector<std::vector<std::tuple<size_t, size_t, double, double>>>
+    allowed_edges_;
   double loglik_;
   double threshold_;
   double psi0_; // initial prior probability for mbicv
+  // whether selection was cancelled and only a partial model is available
+  bool cancelled_{ false };
 
   double get_next_threshold(std::vector<double>& thresholded_crits);
 
@@ -188,10 +244,7 @@ protected:
 
   void remove_vertex_data(VineTree& tree);
 
-  void select_pair_copulas(VineTree& tree,
-                           const VineTree& tree_opt = VineTree());
-
-  FoundEdge find_old_fit(double fit_id, const VineTree& old_graph);
+  void select_pair_copulas(VineTree& tree);
 
   double get_tree_loglik(const VineTree& tree);
 
@@ -8,6 +8,8 @@
 
 #include "gtest/gtest.h"
 #include <vinecopulib.hpp>
+#include <vinecopulib/bicop/tools_select.hpp>
+#include <wdm/eigen.hpp>
 
 namespace test_bicop_select {
 using namespace vinecopulib;
@@ -68,4 +70,129 @@ TEST(bicop_select, fit_stats_are_correct)
   EXPECT_NEAR(cop.get_mbic(), cop.mbic(u), 1e-10);
   EXPECT_NEAR(cop.get_mbic(), cop.mbic(), 1e-10);
 }
+
+TEST(bicop_select, warm_start_works)
+{
+  Bicop cop(BicopFamily::bb1, 0, Eigen::Vector2d(0.5, 1.5));
+  auto u = cop.simulate(500);
+  FitControlsBicop controls({ BicopFamily::bb1 });
+  Bicop fit_cold, fit_warm;
+  fit_cold.select(u, controls);
+  fit_warm = fit_cold;
+  controls.set_warm_start(true);
+  fit_warm.select(u, controls);
+  EXPECT_EQ(fit_cold.get_family(), fit_warm.get_family());
+  EXPECT_EQ(fit_cold.get_rotation(), fit_warm.get_rotation());
+  EXPECT_GE(fit_warm.get_loglik(), fit_cold.get_loglik() - 1e-3);
+
+  // a refit starting from the current parameters saves work
+  Bicop refit_cold(BicopFamily::bb1), refit_warm = fit_cold;
+  controls.set_warm_start(false);
+  refit_cold.fit(u, controls);
+  controls.set_warm_start(true);
+  refit_warm.fit(u, controls);
+  EXPECT_LT(refit_warm.get_num_objective_calls(),
+            refit_cold.get_num_objective_calls());
+  EXPECT_NEAR(refit_warm.get_loglik(), refit_cold.get_loglik(), 1e-3);
+
+  // only the neighbors of the current family are considered
+  controls.set_family_set({});
+  controls.set_warm_start_neighbors(true);
+  fit_warm.select(cop.simulate(500), controls);
+  auto neighbors = tools_select::get_neighbor_families(BicopFamily::bb1);
+  EXPECT_TRUE(tools_stl::is_member(fit_warm.get_family(), neighbors));
+}
+
+TEST(bicop_select, pruning_works)
+{
+  Bicop cop(BicopFamily::gaussian, 0, Eigen::VectorXd::Constant(1, 0.7));
+  auto u = cop.simulate(500);
+  Bicop fit1, fit2;
+  fit1.select(u);
+  EXPECT_EQ(fit1.get_num_skipped_fits(), 0);
+
+  FitControlsBicop controls;
+  controls.set_pruning_margin(10);
+  controls.set_num_threads(2);
+  fit2.select(u, controls);
+  EXPECT_GT(fit2.get_num_skipped_fits(), 0);
+  EXPECT_EQ(fit1.get_family(), fit2.get_family());
+  EXPECT_NEAR(fit1.get_loglik(), fit2.get_loglik(), 1e-10);
+
+  EXPECT_ANY_THROW(controls.set_pruning_margin(-1));
+
+  // families without itau are scored by a capped mle fit and can be pruned
+  u = cop.simulate(500, false, { 1 });
+  FitControlsBicop bb_controls({ BicopFamily::gaussian, BicopFamily::bb7 });
+  fit1.select(u, bb_controls);
+  bb_controls.set_pruning_margin(10);
+  fit2.select(u, bb_controls);
+  EXPECT_EQ(fit2.get_family(), BicopFamily::gaussian);
+  EXPECT_EQ(fit2.get_num_skipped_fits(), 2); // both rotations of BB7
+  EXPECT_LT(fit2.get_num_objective_calls(), fit1.get_num_objective_calls());
+  EXPECT_NEAR(fit1.get_loglik(), fit2.get_loglik(), 1e-10);
+}
+
+TEST(bicop_select, candidates_can_be_fitted_in_any_order)
+{
+  Bicop cop(BicopFamily::clayton, 90, Eigen::VectorXd::Constant(1, 2));
+  auto u = cop.simulate(200);
+  Bicop fit;
+  fit.select(u);
+
+  tools_select::BicopSelector selector(Bicop(), u, FitControlsBicop());
+  for (size_t i = selector.get_num_candidates(); i > 0; --i) {
+    selector.fit_candidate(i - 1);
+  }
+  EXPECT_EQ(fit.str(), selector.get_selected().str());
+  EXPECT_NEAR(fit.get_loglik(), selector.get_selected().get_loglik(), 1e-10);
+}
+
+TEST(bicop_select, dependence_summary_is_shared)
+{
+  Bicop cop(BicopFamily::clayton, 90, Eigen::VectorXd::Constant(1, 2));
+  auto u = cop.simulate(300, false, { 1 });
+  Eigen::VectorXd w = tools_stats::simulate_uniform(300, 1, false, { 2 });
+
+  auto summary = tools_select::summarize_dependence(u, w);
+  EXPECT_EQ(summary.tau, wdm::wdm(u, "tau", w)(0, 1));
+  EXPECT_EQ(summary.c1c2, tools_select::get_c1c2(u, summary.tau, w));
+  EXPECT_NEAR(summary.n_eff, w.sum() * w.sum() / w.squaredNorm(), 1e-10);
+  EXPECT_EQ(tools_select::summarize_dependence(u, Eigen::VectorXd()).n_eff,
+            300);
+  EXPECT_TRUE(tools_select::summarize_dependence(u, w, false).c1c2.empty());
+
+  FitControlsBicop controls;
+  controls.set_weights(w);
+  auto candidates = tools_select::create_candidate_bicops(u, controls);
+  auto candidates2 = tools_select::create_candidate_bicops(controls, summary);
+  ASSERT_EQ(candidates.size(), candidates2.size());
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    EXPECT_EQ(candidates[i].str(), candidates2[i].str());
+  }
+
+  // fits with the shared tau are the same as stand-alone fits
+  Bicop fit;
+  fit.select(u, controls);
+  Bicop refit(fit.get_family(), fit.get_rotation());
+  refit.fit(u, controls);
+  EXPECT_NEAR(fit.get_loglik(), refit.get_loglik(), 1e-10);
+  controls.set_parametric_method("itau");
+  controls.set_family_set({ BicopFamily::clayton });
+  fit.select(u, controls);
+  refit = Bicop(BicopFamily::clayton, fit.get_rotation());
+  refit.fit(u, controls);
+  EXPECT_EQ(fit.get_parameters(), refit.get_parameters());
+
+  // a known tau isn't recomputed
+  EXPECT_EQ(tools_select::summarize_dependence(u, w, true, 0.25).tau, 0.25);
+  tools_select::BicopSelector selector(Bicop(), u, controls, summary.tau);
+  for (size_t i = 0; i < selector.get_num_candidates(); ++i) {
+    selector.fit_candidate(i);
+  }
+  EXPECT_EQ(fit.str(), selector.get_selected().str());
+  EXPECT_NEAR(fit.get_parameters()(0),
+              selector.get_selected().get_parameters()(0),
+              1e-10);
+}
 }
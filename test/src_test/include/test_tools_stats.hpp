@@ -8,7 +8,11 @@
 
 #include "test_vinecop_sanity_checks.hpp"
 #include "gtest/gtest.h"
+#include <boost/math/distributions.hpp>
 #include <vinecopulib.hpp>
+#include <vinecopulib/misc/tools_batch.hpp>
+#include <vinecopulib/misc/tools_random.hpp>
+#include <vinecopulib/misc/tools_stats_sobol.hpp>
 
 namespace test_tools_stats {
 
@@ -52,6 +56,83 @@ TEST(test_tools_stats, to_pseudo_obs_is_correct)
   auto u = tools_stats::to_pseudo_obs(X2);
   EXPECT_TRUE(std::isnan(u(0, 0)));
   EXPECT_GE(u.col(0).tail(50).maxCoeff(), 0.98);
+
+  // long columns with ties (sorted by radix sort), compared with the ranks
+  // from an order-statistic tree
+  Eigen::MatrixXd X3 =
+    (20 * tools_stats::simulate_normal(5000, 3, false, { 1 })).array().round();
+  X3(10, 1) = NAN;
+  for (std::string ties_method : { "average", "min", "max" }) {
+    tools_stats::OnlinePseudoObs online(3, ties_method);
+    online.insert(X3);
+    auto u1 = tools_stats::to_pseudo_obs(X3, ties_method);
+    auto u2 = online.get_pseudo_obs(X3);
+    auto u3 = tools_stats::to_pseudo_obs(X3, ties_method, {}, {}, 3);
+    EXPECT_TRUE(u1.array().isNaN().select(0.0, u1 - u2).isZero(1e-15));
+    EXPECT_TRUE(u1.array().isNaN().select(0.0, u1 - u3).isZero(0.0));
+    EXPECT_TRUE(std::isnan(u3(10, 1)));
+  }
+  Eigen::VectorXd ranks =
+    5001 * tools_stats::to_pseudo_obs_1d(X3.col(0), "first");
+  std::vector<double> sorted_ranks(ranks.data(), ranks.data() + 5000);
+  std::sort(sorted_ranks.begin(), sorted_ranks.end());
+  for (size_t i = 0; i < 5000; i++) {
+    EXPECT_NEAR(sorted_ranks[i], static_cast<double>(i) + 1.0, 1e-9);
+  }
+}
+
+TEST(test_tools_stats, online_pseudo_obs_is_correct)
+{
+  // data with ties
+  Eigen::MatrixXd x = (10 * tools_stats::simulate_uniform(300, 3, false, { 1 }))
+                        .array()
+                        .round();
+
+  // a rolling window of 100 observations
+  tools_stats::OnlinePseudoObs online(3);
+  online.insert(x.topRows(100));
+  for (Eigen::Index start = 0; start <= 200; start += 50) {
+    Eigen::MatrixXd window = x.middleRows(start, 100);
+    EXPECT_EQ(online.get_n(), static_cast<size_t>(100));
+    EXPECT_TRUE(online.get_pseudo_obs(window).isApprox(
+      tools_stats::to_pseudo_obs(window), 1e-15));
+    if (start < 200) {
+      online.insert(x.middleRows(start + 100, 50));
+      online.erase(x.middleRows(start, 50));
+    }
+  }
+
+  // ties methods, missing values, and values that are not among the
+  // observations
+  tools_stats::OnlinePseudoObs online_min(1, "min"), online_max(1, "max");
+  Eigen::MatrixXd y(6, 1), z(4, 1);
+  y << 1, 2, 2, 2, 3, std::numeric_limits<double>::quiet_NaN();
+  z << 2, 0, 2.5, std::numeric_limits<double>::quiet_NaN();
+  online_min.insert(y);
+  online_max.insert(y);
+  Eigen::VectorXd u_min = online_min.get_pseudo_obs(z);
+  Eigen::VectorXd u_max = online_max.get_pseudo_obs(z);
+  Eigen::VectorXd u_min_true(3), u_max_true(3);
+  u_min_true << 2.0 / 6, 1.0 / 6, 5.0 / 6;
+  u_max_true << 4.0 / 6, 1.0 / 6, 5.0 / 6;
+  EXPECT_TRUE(u_min.head(3).isApprox(u_min_true));
+  EXPECT_TRUE(u_max.head(3).isApprox(u_max_true));
+  EXPECT_TRUE(std::isnan(u_min(3)));
+
+  EXPECT_THROW(online_min.erase(z.topRows(2)), std::runtime_error);
+  EXPECT_THROW(tools_stats::OnlinePseudoObs(1, "random"), std::runtime_error);
+
+  // a failed erase leaves the object unchanged
+  Eigen::MatrixXd u_before = online.get_pseudo_obs(x);
+  Eigen::MatrixXd bad = x.bottomRows(2);
+  bad(1, 2) = 0.5; // not among the observations
+  EXPECT_THROW(online.erase(bad), std::runtime_error);
+  bad = x.bottomRows(1).replicate(100, 1); // more often than added
+  EXPECT_THROW(online.erase(bad), std::runtime_error);
+  EXPECT_EQ(online.get_n(), static_cast<size_t>(100));
+  EXPECT_EQ(online.get_pseudo_obs(x), u_before);
+  online.erase(x.bottomRows(100));
+  EXPECT_EQ(online.get_n(), static_cast<size_t>(0));
 }
 
 TEST(test_tools_stats, qrng_are_correct)
@@ -89,6 +170,113 @@ TEST(test_tools_stats, qrng_are_correct)
   }
 }
 
+TEST(test_tools_stats, sobol_direction_numbers_are_correct)
+{
+  // compare with the table of Joe and Kuo (2008)
+  tools_stats::tools_sobol::DirectionNumberReader reader;
+  size_t a;
+  std::vector<size_t> m;
+  std::vector<std::vector<size_t>> m_first = {
+    { 1 }, { 1, 3 }, { 1, 3, 1 }
+  };
+  for (size_t j = 0; j < 3; ++j) {
+    reader.next(a, m);
+    EXPECT_EQ(a, static_cast<size_t>(j == 0 ? 0 : 1));
+    EXPECT_EQ(m, m_first[j]);
+  }
+  for (size_t j = 3; j < tools_stats::tools_sobol::max_dim - 1; ++j) {
+    reader.next(a, m);
+  }
+  std::vector<size_t> m_last = { 1,    1,    7,     11,    15,     7,
+                                 37,   239,  337,   245,   1557,   3681,
+                                 7357, 9639, 27367, 26869, 114603, 86317 };
+  EXPECT_EQ(a, static_cast<size_t>(131059));
+  EXPECT_EQ(m, m_last);
+
+  EXPECT_THROW(tools_stats::sobol(10, tools_stats::tools_sobol::max_dim + 1),
+               std::runtime_error);
+}
+
+TEST(test_tools_stats, qrng_sequences_can_skip_ahead)
+{
+  size_t n = 1000, d = 10;
+  tools_stats::GhaltonSequence gh(d, { 1, 2 });
+  tools_stats::SobolSequence sob(d, { 1, 2 });
+
+  auto u_gh = tools_stats::ghalton(n, d, { 1, 2 });
+  auto u_sob = tools_stats::sobol(n, d, { 1, 2 });
+  EXPECT_TRUE(gh.generate(0, n) == u_gh);
+  EXPECT_TRUE(sob.generate(0, n) == u_sob);
+  EXPECT_TRUE(gh.generate(377, 200) == u_gh.middleRows(377, 200));
+  EXPECT_TRUE(sob.generate(377, 200) == u_sob.middleRows(377, 200));
+
+  // the result does not depend on the number of threads
+  EXPECT_TRUE(tools_stats::ghalton(n, d, { 1, 2 }, 4) == u_gh);
+  EXPECT_TRUE(tools_stats::sobol(n, d, { 1, 2 }, 4) == u_sob);
+}
+
+TEST(test_tools_stats, sobol_scrambling_preserves_nets)
+{
+  // the first 2^m points of the first two dimensions form a (0, m, 2)-net:
+  // every box [a 2^-k, (a + 1) 2^-k) x [b 2^-(m - k), (b + 1) 2^-(m - k))
+  // contains exactly one point
+  size_t m = 10, n = size_t{ 1 } << m;
+  for (std::string scrambling : { "owen", "shift" }) {
+    tools_stats::SobolSequence sequence(5, { 1 }, scrambling);
+    auto replicate = sequence.rescramble({ 2 });
+    EXPECT_EQ(replicate.get_scrambling(), scrambling);
+    for (const auto& seq : { sequence, replicate }) {
+      auto u = seq.generate(0, n);
+      for (size_t k = 0; k <= m; ++k) {
+        std::vector<int> counts(n, 0);
+        for (size_t i = 0; i < n; ++i) {
+          auto a = static_cast<size_t>(u(i, 0) * std::pow(2.0, k));
+          auto b = static_cast<size_t>(u(i, 1) * std::pow(2.0, m - k));
+          counts[(a << (m - k)) + b]++;
+        }
+        EXPECT_EQ(*std::min_element(counts.begin(), counts.end()), 1);
+      }
+    }
+    EXPECT_FALSE(sequence.generate(0, n) == replicate.generate(0, n));
+  }
+
+  // points beyond 2^32 are available
+  tools_stats::SobolSequence sequence(3, { 1 });
+  auto u = sequence.generate(size_t{ 1 } << 40, 10);
+  EXPECT_GT(u.minCoeff(), 0.0);
+  EXPECT_LT(u.maxCoeff(), 1.0);
+  EXPECT_THROW(tools_stats::SobolSequence(3, { 1 }, "foo"), std::runtime_error);
+}
+
+TEST(test_tools_stats, philox_is_correct)
+{
+  // known answers of the Random123 library
+  tools_random::Philox4x32 philox0({ 0, 0 });
+  tools_random::Philox4x32::Counter expected0 = {
+    0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8
+  };
+  EXPECT_EQ(philox0({ 0, 0, 0, 0 }), expected0);
+
+  tools_random::Philox4x32 philox1({ 0xa4093822, 0x299f31d0 });
+  tools_random::Philox4x32::Counter expected1 = {
+    0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1
+  };
+  EXPECT_EQ(philox1({ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }),
+            expected1);
+}
+
+TEST(test_tools_stats, simulate_uniform_does_not_depend_on_threads)
+{
+  auto u = tools_stats::simulate_uniform(5000, 7, false, { 1, 2 });
+  EXPECT_TRUE(tools_stats::simulate_uniform(5000, 7, false, { 1, 2 }, 4) == u);
+  // rows and columns are the same for a larger sample
+  auto u_large = tools_stats::simulate_uniform(6000, 8, false, { 1, 2 });
+  EXPECT_TRUE(u_large.topLeftCorner(5000, 7) == u);
+  EXPECT_GT(u.minCoeff(), 0.0);
+  EXPECT_LT(u.maxCoeff(), 1.0);
+  EXPECT_NEAR(u.mean(), 0.5, 0.01);
+}
+
 TEST(test_tools_stats, mcor_works)
 {
   std::vector<int> seeds = { 1, 2, 3, 4, 5 };
@@ -105,6 +293,75 @@ TEST(test_tools_stats, mcor_works)
   weights.block(5000, 0, 5000, 1) = Eigen::VectorXd::Zero(5000);
   a2 = tools_stats::pairwise_mcor(Z, weights);
   ASSERT_TRUE(std::fabs(a1 - a2) < 0.05);
+
+  // batched evaluation of all pairs
+  Eigen::MatrixXd X(1000, 3);
+  X << Z.topRows(1000), Z.col(0).head(1000).array().sin().matrix();
+  Eigen::MatrixXd mcor = tools_stats::mcor_matrix(X, Eigen::VectorXd(), 2);
+  EXPECT_TRUE(mcor.diagonal().isOnes());
+  EXPECT_TRUE(mcor.isApprox(mcor.transpose()));
+  EXPECT_NEAR(mcor(0, 1), tools_stats::pairwise_mcor(X.leftCols(2)), 1e-15);
+  Eigen::MatrixXd X20(1000, 2);
+  X20 << X.col(2), X.col(0);
+  EXPECT_NEAR(mcor(2, 0), tools_stats::pairwise_mcor(X20), 1e-15);
+  EXPECT_GT(mcor(2, 0), 0.95);
+}
+
+TEST(test_tools_stats, ktau_pairs_is_correct)
+{
+  // (weighted) tau_b by counting all pairs
+  auto ktau = [](const Eigen::MatrixXd& x,
+                 Eigen::VectorXd w = Eigen::VectorXd()) {
+    if (w.size() == 0) {
+      w = Eigen::VectorXd::Ones(x.rows());
+    }
+    double c = 0, ties1 = 0, ties2 = 0, n0 = 0;
+    for (Eigen::Index i = 0; i < x.rows(); i++) {
+      for (Eigen::Index j = 0; j < i; j++) {
+        double s = (x(i, 0) - x(j, 0)) * (x(i, 1) - x(j, 1));
+        c += w(i) * w(j) * ((s > 0) - (s < 0));
+        ties1 += w(i) * w(j) * (x(i, 0) == x(j, 0));
+        ties2 += w(i) * w(j) * (x(i, 1) == x(j, 1));
+        n0 += w(i) * w(j);
+      }
+    }
+    return c / std::sqrt((n0 - ties1) * (n0 - ties2));
+  };
+
+  Eigen::MatrixXd u = tools_stats::simulate_uniform(300, 6, false, { 1 });
+  u.col(1) = (u.col(0) + u.col(1)) / 2; // dependent
+  u.col(3) = (10 * u.col(3)).array().floor();
+  u.col(4) = (5 * u.col(4)).array().floor(); // ties in both variables
+  u.col(5) = (5 * (u.col(4) + u.col(5))).array().floor();
+  u(10, 2) = NAN;
+  u(20, 3) = NAN;
+
+  auto tau = tools_stats::ktau_pairs(u);
+  ASSERT_EQ(tau.size(), 3);
+  EXPECT_NEAR(tau(0), ktau(u.leftCols(2)), 1e-12);
+  EXPECT_NEAR(tau(2), ktau(u.rightCols(2)), 1e-12);
+  Eigen::MatrixXd u23 = u.middleCols(2, 2);
+  tools_eigen::remove_nans(u23);
+  EXPECT_EQ(u23.rows(), 298);
+  EXPECT_NEAR(tau(1), ktau(u23), 1e-12);
+  EXPECT_EQ(tau, tools_stats::ktau_pairs(u, Eigen::VectorXd(), 2));
+
+  Eigen::VectorXd w = tools_stats::simulate_uniform(300, 1, false, { 2 });
+  auto tau_w = tools_stats::ktau_pairs(u, w, 2);
+  EXPECT_NEAR(tau_w(0), ktau(u.leftCols(2), w), 1e-12);
+  EXPECT_NEAR(tau_w(2), ktau(u.rightCols(2), w), 1e-12);
+  Eigen::VectorXd w23 = w;
+  u23 = u.middleCols(2, 2);
+  tools_eigen::remove_nans(u23, w23);
+  EXPECT_NEAR(tau_w(1), ktau(u23, w23), 1e-12);
+  EXPECT_NEAR(tools_stats::ktau_pairs(u, Eigen::VectorXd::Ones(300))(2),
+              tau(2),
+              1e-12);
+  EXPECT_ANY_THROW(tools_stats::ktau_pairs(u, w.head(10)));
+
+  Eigen::MatrixXd constant = Eigen::MatrixXd::Ones(5, 2);
+  EXPECT_TRUE(std::isnan(tools_stats::ktau_pairs(constant)(0)));
+  EXPECT_ANY_THROW(tools_stats::ktau_pairs(u.leftCols(3)));
 }
 
 TEST(test_tools_stats, seed_works)
@@ -187,6 +444,191 @@ TEST(test_tools_stats, pbvt_and_pbvnorm_are_nan_safe)
   int nu = 5;
   EXPECT_NO_THROW(tools_stats::pbvt(X, nu, rho));
   EXPECT_NO_THROW(tools_stats::pbvnorm(X, rho));
+  EXPECT_TRUE(std::isnan(tools_stats::pbvt(X, nu, rho)(0)));
+  EXPECT_TRUE(std::isnan(tools_stats::pbvnorm(X, rho)(0)));
+  EXPECT_FALSE(std::isnan(tools_stats::pbvnorm(X, rho)(1)));
+}
+
+TEST(test_tools_stats, pbvt_and_pbvnorm_are_correct)
+{
+  // 300 rows, so that several blocks are evaluated
+  Eigen::MatrixXd z = 3 * Eigen::MatrixXd::Random(300, 2);
+  Eigen::MatrixXd z_neg = z;
+  z_neg.col(1) *= -1;
+  Eigen::MatrixXd origin = Eigen::MatrixXd::Zero(1, 2);
+  for (double rho : { -0.99, -0.95, -0.6, -0.2, 0.0, 0.1, 0.5, 0.8, 0.97 }) {
+    // closed form at the origin
+    double p0 =
+      0.25 + std::asin(rho) / (2 * boost::math::constants::pi<double>());
+    EXPECT_NEAR(tools_stats::pbvnorm(origin, rho)(0), p0, 1e-14);
+    // P(X <= h, Y <= k) + P(X <= h, -Y <= -k) = P(X <= h)
+    Eigen::VectorXd p = tools_stats::pbvnorm(z, rho);
+    Eigen::VectorXd p_neg = tools_stats::pbvnorm(z_neg, -rho);
+    Eigen::VectorXd p1 = tools_stats::pnorm(z.col(0));
+    EXPECT_LT((p + p_neg - p1).cwiseAbs().maxCoeff(), 1e-14);
+    for (int nu : { 1, 4, 5, 20 }) {
+      EXPECT_NEAR(tools_stats::pbvt(origin, nu, rho)(0), p0, 1e-14);
+      p = tools_stats::pbvt(z, nu, rho);
+      p_neg = tools_stats::pbvt(z_neg, nu, -rho);
+      p1 = tools_stats::pt(z.col(0), nu);
+      EXPECT_LT((p + p_neg - p1).cwiseAbs().maxCoeff(), 1e-13);
+    }
+  }
+}
+
+TEST(test_tools_stats, pbvt_and_pbvnorm_match_reference_values)
+{
+  // computed by the previous, row-by-row implementation
+  Eigen::MatrixXd z(6, 2), u(6, 2);
+  z << -2.5, 1.3, 0.4, -0.7, 1.9, 2.2, -0.3, -3.1, 6.0, -1.1, -1.6, -1.4;
+  u << 0.1, 0.8, 0.5, 0.3, 0.95, 0.97, 0.4, 0.02, 0.999, 0.2, 0.05, 0.08;
+  std::vector<double> rhos = { -0.999, -0.9, -0.3, 0.4, 0.95, 0.999 };
+  std::vector<int> nus = { 1, 3, 7, 30 };
+  std::vector<std::vector<double>> ref_pbvnorm = {
+    { 7.2946422757103078e-163, 2.1622523661833894e-14,
+      0.95737999267049956, 0,
+      0.13566605995979503, 0 },
+    { 3.0997732150846516e-05, 0.023243927692197852,
+      0.95737999267049956, 1.2029223103726672e-16,
+      0.13566605995979503, 2.564138137928218e-13 },
+    { 0.004234695734023488, 0.1223359302992218,
+      0.95741759259875769, 8.2303687405497475e-05,
+      0.13566606017378746, 0.0010012144476886139 },
+    { 0.0061832511430539201, 0.20226685799070421,
+      0.95975690618464682, 0.00084438399342986049,
+      0.13566606094633121, 0.014372497690059369 },
+    { 0.0062096653257761383, 0.24195561961577763,
+      0.96990289816235353, 0.0009676032132183561,
+      0.13566606094638267, 0.048305426402152768 },
+    { 0.0062096653257761383, 0.24196365222307303,
+      0.97128344018399504, 0.0009676032132183561,
+      0.13566606094638267, 0.054799287094018982 }
+  };
+  std::vector<std::vector<double>> ref_pbvt = {
+    { 0.00013243398996175837, 0.00052679758618661993,
+      0.71002495872114468, 4.6810136329088745e-05,
+      0.18231784656224145, 5.3055303852722788e-05 },
+    { 0.011740568783311691, 0.036031078771941893,
+      0.71390579498927265, 0.0046802855618243277,
+      0.18548380089430444, 0.0053432381120912358 },
+    { 0.057588937316702796, 0.14064122409485935,
+      0.7394335865199031, 0.032931788809071529,
+      0.20299357150867756, 0.039564607900292807 },
+    { 0.094556679016193065, 0.22790677336291851,
+      0.77712827457609035, 0.06722782047472585,
+      0.22090440929841509, 0.08877614461918143 },
+    { 0.11901651432495809, 0.29846776675448339,
+      0.83103444646454916, 0.09650117157582068,
+      0.2337298788192711, 0.15797004397509307 },
+    { 0.12107705544705427, 0.30545524447555228,
+      0.84526981511143229, 0.099269258141464201,
+      0.23483141037715471, 0.17704176289041673 },
+    { 4.7430602247410794e-07, 2.8530918729066917e-05,
+      0.86559826435560006, 2.1026406419401332e-08,
+      0.17120524704255335, 3.0614010739155647e-08 },
+    { 0.0024436702553083459, 0.028351992868875485,
+      0.86571604595262841, 0.00019674521157146945,
+      0.1712682106271772, 0.0002918953276378226 },
+    { 0.023847823152365083, 0.12962882276601304,
+      0.87094339229151374, 0.0068487424946694006,
+      0.17295389949303167, 0.011530624622930578 },
+    { 0.039166579344426203, 0.21257619115779663,
+      0.8870266144485135, 0.019424603276195024,
+      0.17510381886872528, 0.041296941844966469 },
+    { 0.043816194628199016, 0.26591433999570546,
+      0.91682292736726101, 0.026559524784994265,
+      0.17583587582096694, 0.091813391364769487 },
+    { 0.0438533084372148, 0.2671628808066695,
+      0.92315785779457948, 0.026647734684632413,
+      0.17584159515715389, 0.10387076811898285 },
+    { 7.7395113408518166e-11, 8.6569699784560489e-07,
+      0.91853148261501472, 5.4784337513663399e-14,
+      0.15358699837604742, 1.3152555960294067e-13 },
+    { 0.00059850531934470556, 0.025540132635762134,
+      0.91853269101098711, 3.7293962997136444e-06,
+      0.15358727936229838, 8.9715296335560193e-06 },
+    { 0.012247301052868443, 0.12562347406526658,
+      0.91965957482943117, 0.0016687636237203989,
+      0.1536824364095779, 0.0044907845173892385 },
+    { 0.019548767187121792, 0.20694417522259745,
+      0.92760584513393507, 0.0067382748290631799,
+      0.15383820926090749, 0.025669394995938032 },
+    { 0.020495970660970041, 0.25300297607496203,
+      0.94694800449321703, 0.0086601785411734005,
+      0.15385812568129364, 0.067718985101563753 },
+    { 0.020496109292851287, 0.25325877595425322,
+      0.95039628386643349, 0.0086611447125360865,
+      0.15385812754704431, 0.076808148813466745 },
+    { 9.9647299604506479e-18, 3.6670533900438824e-10,
+      0.94863431800228371, 8.7151352049433274e-18,
+      0.14003976190538148, 7.1542208090261508e-17 },
+    { 9.1314552322979887e-05, 0.023793043617655888,
+      0.94863431800843934, 2.4869351743901063e-10,
+      0.14003976190541007, 3.9645959832320561e-09 },
+    { 0.0059367075606202571, 0.12312456435047027,
+      0.94876789577354359, 0.0002488255318198059,
+      0.14003996408385397, 0.0016128505285383083 },
+    { 0.0089558891269556178, 0.20339471757494768,
+      0.95225689390102042, 0.0017585155256628531,
+      0.14004045451361016, 0.016912071057602861 },
+    { 0.0090578245340268704, 0.24463104806667488,
+      0.96462816394746753, 0.0020922424238495473,
+      0.14004045904381987, 0.052913021975515409 },
+    { 0.0090578245340333895, 0.24466022174983587,
+      0.96645853782116664, 0.0020922424302753291,
+      0.14004045904382001, 0.060039105586413996 }
+  };
+  // Student copula with nu = 4.5 (interpolates between pbvt() for nu = 4, 5)
+  std::vector<std::vector<double>> ref_student = {
+    { 0.036752562349861448, 0.064254209222191994,
+      0.92042631354922733, 0.0014532696361382225,
+      0.19911334339813561, 0.00091424027060610044 },
+    { 0.09999999871151441, 0.29999947756403655,
+      0.94999873276013058, 0.01999999911743025,
+      0.19999999998909174, 0.049997838173804959 }
+  };
+
+  // 300 rows, so that several blocks are evaluated
+  Eigen::MatrixXd z_rep = z.replicate(50, 1), u_rep = u.replicate(50, 1);
+  auto expect_equal = [](const Eigen::VectorXd& p,
+                         const std::vector<double>& ref) {
+    for (Eigen::Index i = 0; i < p.size(); i++) {
+      EXPECT_NEAR(p(i), ref[i % 6], 1e-12);
+    }
+  };
+  for (size_t r = 0; r < rhos.size(); r++) {
+    expect_equal(tools_stats::pbvnorm(z_rep, rhos[r]), ref_pbvnorm[r]);
+    for (size_t k = 0; k < nus.size(); k++) {
+      expect_equal(tools_stats::pbvt(z_rep, nus[k], rhos[r]),
+                   ref_pbvt[k * rhos.size() + r]);
+    }
+  }
+  std::vector<double> student_rhos = { -0.6, 0.999 };
+  for (size_t r = 0; r < student_rhos.size(); r++) {
+    Bicop cop(BicopFamily::student, 0, Eigen::Vector2d(student_rhos[r], 4.5));
+    expect_equal(cop.cdf(u_rep), ref_student[r]);
+  }
+}
+
+TEST(test_tools_stats, create_batches_covers_range)
+{
+  for (size_t num_tasks : { 1, 10, 999, 10000 }) {
+    auto batches = tools_batch::create_batches(num_tasks, 4, 5);
+    size_t begin = 0;
+    for (const auto& batch : batches) {
+      EXPECT_EQ(batch.begin, begin);
+      EXPECT_TRUE((batch.size >= 5) || (batches.size() == 1));
+      begin += batch.size;
+    }
+    EXPECT_EQ(begin, num_tasks);
+  }
+
+  // batches get smaller towards the end of the range
+  auto batches = tools_batch::create_batches(10000, 4);
+  EXPECT_GT(batches.front().size, batches.back().size);
+
+  // cheap work stays in one batch
+  EXPECT_EQ(tools_batch::create_batches(100, 4, 200).size(), 1u);
 }
 
 TEST(test_tools_stats, find_latent_sample)
@@ -207,5 +649,60 @@ TEST(test_tools_stats, find_latent_sample)
   u.resize(2, 8);
   EXPECT_THROW(tools_stats::find_latent_sample(u, bandwidth, niter),
                std::runtime_error);
+
+  // the ranks are computed concurrently
+  Eigen::MatrixXd v = tools_stats::simulate_uniform(500, 2, false, { 1 });
+  u.resize(500, 4);
+  u << (4 * v).array().ceil() / 4, (4 * v).array().floor() / 4;
+  EXPECT_TRUE(tools_stats::find_latent_sample(u, 0.3, 3, 1) ==
+              tools_stats::find_latent_sample(u, 0.3, 3, 4));
+}
+
+TEST(test_tools_stats, box_covering_is_correct)
+{
+  Eigen::MatrixXd u = tools_stats::simulate_uniform(2000, 2, false, { 1 });
+  u.row(0) << 1.0, 1.0;
+  u.row(1) << 0.0, 0.5;
+  Eigen::MatrixXd q = tools_stats::simulate_uniform(100, 5, false, { 2 });
+  Eigen::MatrixXd moves = tools_stats::simulate_uniform(500, 2, false, { 3 });
+  Eigen::VectorXd lower(2), upper(2);
+  for (uint16_t K : std::vector<uint16_t>{ 1, 3, 40 }) {
+    Eigen::MatrixXd v = u;
+    tools_stats::BoxCovering covering(v, K);
+    for (size_t r = 0; r < 100; r++) {
+      if (r == 50) {
+        // samples are moved to other (or the same) cells
+        for (size_t i = 0; i < 500; i++) {
+          v.row(4 * i) = (i % 5 == 0) ? v.row(4 * i) : moves.row(i);
+          covering.swap_sample(4 * i, v.row(4 * i).transpose());
+        }
+      }
+      lower << std::min(q(r, 0), q(r, 1)), std::min(q(r, 2), q(r, 3));
+      upper << std::max(q(r, 0), q(r, 1)), std::max(q(r, 2), q(r, 3));
+      if (r == 0) {
+        lower << 0.0, 0.0;
+        upper << 1.0, 1.0;
+      }
+
+      std::vector<size_t> expected;
+      for (size_t i = 0; i < 2000; i++) {
+        if ((v.row(i).transpose().array() >= lower.array()).all() &&
+            (v.row(i).transpose().array() <= upper.array()).all()) {
+          expected.push_back(i);
+        }
+      }
+      auto indices = covering.get_box_indices(lower, upper);
+      auto selected = covering.sample_box_index(lower, upper, q(r, 4));
+      if (indices.empty()) {
+        EXPECT_EQ(selected, -1);
+      } else {
+        size_t m =
+          static_cast<size_t>(q(r, 4) * static_cast<double>(indices.size()));
+        EXPECT_EQ(selected, static_cast<ptrdiff_t>(indices[m]));
+      }
+      std::sort(indices.begin(), indices.end());
+      EXPECT_EQ(indices, expected);
+    }
+  }
 }
 }
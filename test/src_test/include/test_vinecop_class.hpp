@@ -7,9 +7,12 @@
 #pragma once
 
 #include "vinecop_test.hpp"
+#include <algorithm>
 #include <string>
 #include <vinecopulib.hpp>
 #include <vinecopulib/misc/tools_stl.hpp>
+#include <vinecopulib/misc/tools_thread.hpp>
+#include <vinecopulib/vinecop/tools_select.hpp>
 
 namespace test_vinecop_class {
 using namespace vinecopulib;
@@ -509,6 +512,353 @@ TEST_F(VinecopTest, works_multi_threaded)
   fit2.cdf(u, 100, 2);
 }
 
+TEST_F(VinecopTest, custom_executor_works)
+{
+  u.conservativeResize(100, 7);
+  FitControlsVinecop controls({ BicopFamily::gaussian });
+  Vinecop fit(u, RVineStructure(), {}, controls);
+  auto pdf = fit.pdf(u);
+
+  tools_thread::set_executor(std::make_shared<tools_thread::Executor>(3));
+  EXPECT_TRUE(fit.pdf(u, 4).isApprox(pdf, 1e-10));
+
+  // pinned workers process contiguous parts of the data
+  tools_thread::set_executor(
+    std::make_shared<tools_thread::Executor>(3, true));
+  EXPECT_TRUE(fit.pdf(u, 4).isApprox(pdf, 1e-10));
+  auto v = fit.rosenblatt(u);
+  EXPECT_TRUE(fit.rosenblatt(u, 4).isApprox(v, 1e-10));
+  EXPECT_TRUE(fit.inverse_rosenblatt(v, 4).isApprox(u, 1e-6));
+
+  // executor without workers does everything in the calling thread
+  tools_thread::set_executor(std::make_shared<tools_thread::Executor>(0));
+  EXPECT_TRUE(fit.pdf(u, 4).isApprox(pdf, 1e-10));
+  tools_thread::set_executor(nullptr);
+}
+
+TEST_F(VinecopTest, nested_task_groups_work)
+{
+  std::atomic<int> num_done{ 0 };
+  tools_thread::TaskGroup outer(4);
+  for (size_t i = 0; i < 10; ++i) {
+    outer.push([&] {
+      tools_thread::TaskGroup inner(4);
+      for (size_t j = 0; j < 10; ++j) {
+        inner.push([&] { ++num_done; });
+      }
+      inner.wait();
+    });
+  }
+  outer.wait();
+  EXPECT_EQ(num_done, 100);
+
+  tools_thread::TaskGroup group(4);
+  for (size_t i = 0; i < 10; ++i) {
+    group.push([i] {
+      if (i == 5)
+        throw std::runtime_error("task failed");
+    });
+  }
+  EXPECT_THROW(group.wait(), std::runtime_error);
+  group.push([&] { ++num_done; });
+  EXPECT_NO_THROW(group.wait());
+}
+
+TEST_F(VinecopTest, cancellation_works)
+{
+  u.conservativeResize(100, 7);
+  FitControlsVinecop controls({ BicopFamily::gaussian });
+  Vinecop fit(u, RVineStructure(), {}, controls);
+
+  auto token = std::make_shared<CancellationToken>();
+  token->cancel();
+  controls.set_cancellation_token(token);
+  controls.set_num_threads(2);
+  Vinecop vc(7);
+  EXPECT_THROW(vc.select(u, controls), CancelledException);
+  EXPECT_THROW(fit.fit(u, controls, 2), CancelledException);
+
+  // a deadline in the past cancels computations on all threads
+  auto timeout = std::make_shared<CancellationToken>();
+  timeout->set_timeout(std::chrono::seconds(-1));
+  {
+    CancellationScope scope(timeout);
+    EXPECT_THROW(fit.simulate(1e5, false, 2), CancelledException);
+  }
+  EXPECT_NO_THROW(fit.simulate(10, false, 2));
+}
+
+// cancels the selection once the first tree is finished
+class CancellingObserver : public Observer
+{
+public:
+  explicit CancellingObserver(std::shared_ptr<CancellationToken> token)
+    : token_(token)
+  {}
+
+  void on_tree_finish(size_t tree, double) override
+  {
+    if (tree == 0) {
+      token_->cancel();
+    }
+  }
+
+private:
+  std::shared_ptr<CancellationToken> token_;
+};
+
+TEST_F(VinecopTest, cancellation_keeps_completed_trees)
+{
+  u.conservativeResize(100, 7);
+  for (bool sparse : { false, true }) {
+    auto token = std::make_shared<CancellationToken>();
+    FitControlsVinecop controls({ BicopFamily::gaussian });
+    controls.set_cancellation_token(token);
+    controls.set_observer(std::make_shared<CancellingObserver>(token));
+    controls.set_select_trunc_lvl(sparse);
+    controls.set_num_threads(2);
+
+    Vinecop vc(7);
+    EXPECT_NO_THROW(vc.select(u, controls));
+    EXPECT_TRUE(token->is_cancelled());
+    EXPECT_TRUE(vc.is_partial());
+    EXPECT_EQ(vc.get_trunc_lvl(), 1);
+    Eigen::VectorXd pdf = vc.pdf(u);
+    EXPECT_EQ(pdf.size(), 100);
+    EXPECT_TRUE(pdf.allFinite());
+    EXPECT_NEAR(vc.get_loglik(), vc.loglik(u), 1e-6);
+  }
+}
+
+class CountingObserver : public Observer
+{
+public:
+  std::atomic<size_t> trees{ 0 }, msts{ 0 }, fits{ 0 }, edges{ 0 }, rows{ 0 };
+
+  void on_tree_finish(size_t, double) override { trees++; }
+  void on_mst(size_t, size_t, double) override { msts++; }
+  void on_fit(const FitEvent&) override { fits++; }
+  void on_edge(const EdgeEvent&) override { edges++; }
+  void on_batch(const BatchEvent& event) override { rows += event.size; }
+};
+
+TEST_F(VinecopTest, observer_works)
+{
+  u.conservativeResize(100, 7);
+  auto observer = std::make_shared<CountingObserver>();
+  FitControlsVinecop controls({ BicopFamily::gaussian });
+  controls.set_observer(observer);
+  controls.set_num_threads(2);
+
+  Vinecop vc(u, RVineStructure(), {}, controls);
+  EXPECT_EQ(observer->trees, 6u);
+  EXPECT_EQ(observer->msts, 5u); // the last tree has only one edge
+  EXPECT_EQ(observer->edges, 21u);
+  EXPECT_EQ(observer->fits, 21u);
+
+  vc.fit(u, controls, 2);
+  EXPECT_EQ(observer->edges, 42u);
+  EXPECT_EQ(observer->fits, 42u);
+
+  // evaluations report to the observer of the scope
+  vc.pdf(u, 2);
+  EXPECT_EQ(observer->rows, 0u);
+  {
+    ObserverScope scope(observer);
+    vc.pdf(u, 2);
+  }
+  EXPECT_EQ(observer->rows, 100u);
+}
+
+// records the scopes seen by callbacks from the library
+class ScopeObserver : public Observer
+{
+public:
+  std::shared_ptr<CancellationToken> token;
+  bool sees_itself{ false };
+
+  void on_tree_finish(size_t, double) override
+  {
+    token = CancellationScope::get_current();
+  }
+  void on_batch(const BatchEvent&) override
+  {
+    sees_itself = (ObserverScope::get_current().get() == this);
+  }
+};
+
+TEST_F(VinecopTest, scopes_are_shared_with_the_library)
+{
+  u.conservativeResize(100, 7);
+  auto token = std::make_shared<CancellationToken>();
+  auto observer = std::make_shared<ScopeObserver>();
+  FitControlsVinecop controls({ BicopFamily::gaussian });
+  controls.set_cancellation_token(token);
+  controls.set_observer(observer);
+
+  // the scope opened by the library is visible to the caller's code
+  Vinecop vc(u, RVineStructure(), {}, controls);
+  EXPECT_EQ(observer->token, token);
+  EXPECT_EQ(CancellationScope::get_current(), nullptr);
+
+  // and the scope opened by the caller is visible to the library
+  {
+    ObserverScope scope(observer);
+    EXPECT_EQ(ObserverScope::get_current(), observer);
+    vc.pdf(u);
+  }
+  EXPECT_TRUE(observer->sees_itself);
+  EXPECT_EQ(ObserverScope::get_current(), nullptr);
+}
+
+TEST_F(VinecopTest, known_structure_works_multi_threaded)
+{
+  u.conservativeResize(100, 7);
+  FitControlsVinecop controls(bicop_families::itau, "itau");
+  Vinecop fit1(model_matrix);
+  fit1.select(u, controls);
+  controls.set_num_threads(3);
+  Vinecop fit2(model_matrix);
+  fit2.select(u, controls);
+
+  // pair copulas are selected for fixed edges, so order doesn't change
+  EXPECT_EQ(fit1.str(), fit2.str());
+  EXPECT_NEAR(fit1.get_loglik(), fit2.get_loglik(), 1e-10);
+  EXPECT_NEAR(fit2.get_loglik(), fit2.loglik(u), 1e-2);
+
+  // same result as the tree-by-tree selection
+  tools_select::VinecopSelector selector(
+    u, RVineStructure(model_matrix), controls, { 7, "c" });
+  selector.select_all_trees(u);
+  Vinecop fit3(RVineStructure(model_matrix), selector.get_pair_copulas());
+  EXPECT_EQ(fit2.str(), fit3.str());
+  EXPECT_EQ(fit2.get_all_parameters(), fit3.get_all_parameters());
+  EXPECT_NEAR(fit2.get_loglik(), selector.get_loglik(), 1e-10);
+
+  controls.set_trunc_lvl(2);
+  fit2.select(u, controls);
+  EXPECT_EQ(fit2.get_trunc_lvl(), 2);
+  EXPECT_NEAR(fit2.get_loglik(), fit2.loglik(u), 1e-2);
+}
+
+TEST_F(VinecopTest, mcor_criterion_is_correct)
+{
+  u.conservativeResize(200, 7);
+  u.block(0, 0, 20, 1).setConstant(NAN);
+  FitControlsVinecop controls({ BicopFamily::indep });
+  controls.set_tree_criterion("mcor");
+  controls.set_num_threads(2);
+  tools_select::VinecopSelector selector(u, controls, { 7, "c" });
+  selector.select_all_trees(u);
+
+  // edges of the first tree, with and without missing values
+  auto tree = selector.get_trees_opt()[1];
+  EXPECT_EQ(boost::num_edges(tree), 6);
+  Eigen::MatrixXd pair_data(200, 2);
+  for (auto e : boost::edges(tree)) {
+    auto edge = tree[e];
+    pair_data.col(0) = u.col(edge.conditioned[0]);
+    pair_data.col(1) = u.col(edge.conditioned[1]);
+    EXPECT_NEAR(edge.crit,
+                tools_select::calculate_criterion(
+                  pair_data, "mcor", Eigen::VectorXd()),
+                1e-15);
+  }
+
+  Eigen::MatrixXd crits = tools_select::calculate_criterion_matrix(
+    u.rightCols(6), "mcor", Eigen::VectorXd());
+  EXPECT_TRUE(crits.diagonal().isOnes());
+  pair_data << u.col(3), u.col(5);
+  EXPECT_NEAR(crits(2, 4),
+              tools_select::calculate_criterion(
+                pair_data, "mcor", Eigen::VectorXd()),
+              1e-15);
+}
+
+TEST_F(VinecopTest, tau_criterion_is_correct)
+{
+  u.conservativeResize(200, 7);
+  u.block(0, 0, 20, 1).setConstant(NAN);
+  u.block(100, 3, 5, 1).setConstant(NAN);
+  FitControlsVinecop controls({ BicopFamily::indep });
+  controls.set_tree_criterion("tau");
+  controls.set_num_threads(2);
+  tools_select::VinecopSelector selector(u, controls, { 7, "c" });
+  selector.select_all_trees(u);
+
+  // maximum spanning tree of the criteria of all pairs (Kruskal)
+  Eigen::MatrixXd crits =
+    tools_select::calculate_criterion_matrix(u, "tau", Eigen::VectorXd());
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for (size_t i = 1; i < 7; ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      pairs.push_back(std::make_pair(i, j));
+    }
+  }
+  std::sort(pairs.begin(), pairs.end(), [&](const auto& p1, const auto& p2) {
+    return crits(p1.first, p1.second) > crits(p2.first, p2.second);
+  });
+  std::vector<size_t> component = tools_stl::seq_int(0, 7);
+  Eigen::MatrixXi is_mst_edge = Eigen::MatrixXi::Zero(7, 7);
+  for (const auto& p : pairs) {
+    size_t c0 = component[p.first], c1 = component[p.second];
+    if (c0 != c1) {
+      std::replace(component.begin(), component.end(), c1, c0);
+      is_mst_edge(p.first, p.second) = 1;
+      is_mst_edge(p.second, p.first) = 1;
+    }
+  }
+
+  // the first tree and its criteria are those of the per-pair computation
+  auto tree = selector.get_trees_opt()[1];
+  ASSERT_EQ(boost::num_edges(tree), 6);
+  Eigen::MatrixXd pair_data(200, 2);
+  for (auto e : boost::edges(tree)) {
+    auto edge = tree[e];
+    size_t i = edge.conditioned[0], j = edge.conditioned[1];
+    EXPECT_EQ(is_mst_edge(i, j), 1);
+    pair_data << u.col(i), u.col(j);
+    EXPECT_NEAR(edge.crit,
+                tools_select::calculate_criterion(
+                  pair_data, "tau", Eigen::VectorXd()),
+                1e-12);
+    EXPECT_NEAR(edge.crit, crits(i, j), 1e-12);
+  }
+}
+
+TEST_F(VinecopTest, tau_criterion_works_with_weights)
+{
+  u.conservativeResize(200, 7);
+  Eigen::VectorXd w = tools_stats::simulate_uniform(200, 1, false, { 1 });
+  FitControlsVinecop controls({ BicopFamily::clayton, BicopFamily::gumbel },
+                              "itau");
+  controls.set_weights(w);
+  controls.set_num_threads(2);
+  tools_select::VinecopSelector selector(u, controls, { 7, "c" });
+  selector.select_all_trees(u);
+
+  // the edges keep the signed tau for the family selection
+  auto tree = selector.get_trees_opt()[1];
+  EXPECT_EQ(boost::num_edges(tree), 6);
+  Eigen::MatrixXd pair_data(200, 2);
+  for (auto e : boost::edges(tree)) {
+    auto edge = tree[e];
+    pair_data.col(0) = u.col(edge.conditioned[0]);
+    pair_data.col(1) = u.col(edge.conditioned[1]);
+    EXPECT_NEAR(edge.tau, wdm::wdm(pair_data, "tau", w)(0, 1), 1e-10);
+    EXPECT_NEAR(edge.crit,
+                tools_select::calculate_criterion(pair_data, "tau", w),
+                1e-10);
+  }
+
+  // with a fixed structure, the criterion doesn't change the fit
+  Vinecop fit(u, RVineStructure(model_matrix), {}, controls);
+  controls.set_tree_criterion("rho");
+  Vinecop fit_rho(u, RVineStructure(model_matrix), {}, controls);
+  EXPECT_EQ(fit.str(), fit_rho.str());
+  EXPECT_NEAR(fit.get_loglik(), fit_rho.get_loglik(), 1e-8);
+}
+
 // check if the same conditioned sets appear for each tree
 inline size_t
 get_pairs_unequal(
@@ -661,6 +1011,24 @@ TEST_F(VinecopTest, sparse_both_selection)
   fit.select(uu, controls);
 }
 
+TEST_F(VinecopTest, sparse_selection_reuses_fits)
+{
+  u.conservativeResize(100, 7);
+  FitControlsVinecop controls(bicop_families::parametric);
+  controls.set_select_threshold(true);
+  controls.set_selection_criterion("mbicv");
+  Vinecop fit1(7);
+  fit1.select(u, controls);
+
+  // fits re-used across thresholds must coincide with a direct fit
+  controls.set_select_threshold(false);
+  controls.set_threshold(fit1.get_threshold());
+  Vinecop fit2(7);
+  fit2.select(u, controls);
+  EXPECT_EQ(fit1.str(), fit2.str());
+  EXPECT_NEAR(fit1.get_loglik(), fit2.get_loglik(), 1e-10);
+}
+
 TEST_F(VinecopTest, partial_selection)
 {
   u.conservativeResize(20, 7);
@@ -701,4 +1069,32 @@ TEST_F(VinecopTest, tawn_flipping)
   }
 }
 
+TEST_F(VinecopTest, warm_start_works)
+{
+  u.conservativeResize(200, 7);
+  FitControlsVinecop controls(bicop_families::parametric);
+  Vinecop fit1(7);
+  fit1.select(u, controls);
+
+  // refit with the same data and structure
+  Vinecop fit2 = fit1;
+  controls.set_warm_start(true);
+  fit2.select(u, controls);
+  EXPECT_NEAR(fit2.get_loglik(), fit2.loglik(u), 1e-2);
+  EXPECT_GE(fit2.get_loglik(), fit1.get_loglik() - 1e-2);
+
+  // restricting selection to neighbor families
+  controls.set_warm_start_neighbors(true);
+  Vinecop fit3 = fit1;
+  fit3.select(u.bottomRows(100), controls);
+  for (size_t tree = 0; tree < fit1.get_trunc_lvl(); ++tree) {
+    for (size_t edge = 0; edge < 6 - tree; ++edge) {
+      auto neighbors = tools_select::get_neighbor_families(
+        fit1.get_pair_copula(tree, edge).get_family());
+      auto family = fit3.get_pair_copula(tree, edge).get_family();
+      EXPECT_TRUE(tools_stl::is_member(family, neighbors));
+    }
+  }
+}
+
 }
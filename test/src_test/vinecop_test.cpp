@@ -6,6 +6,7 @@
 
 #include "include/vinecop_test.hpp"
 #include <stdexcept>
+#include <vinecopulib/misc/tools_eigen.hpp>
 
 VinecopTest::VinecopTest()
 {
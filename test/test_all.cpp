@@ -15,6 +15,7 @@
 #include "src_test/include/test_vinecop_class.hpp"
 #include "src_test/include/test_vinecop_sanity_checks.hpp"
 #include "src_test/include/test_weights.hpp"
+#include <vinecopulib/misc/tools_memory.hpp>
 
 using namespace test_bicop_sanity_checks;
 using namespace test_bicop_parametric;
@@ -29,9 +30,32 @@ using namespace test_vinecop_sanity_checks;
 using namespace test_weights;
 using namespace test_weights;
 
+// Reports the allocations of each test (with VINECOPULIB_MEMORY_STATS)
+class MemoryListener : public ::testing::EmptyTestEventListener
+{
+  void OnTestStart(const ::testing::TestInfo&) override
+  {
+    tools_memory::reset_peak_rss();
+    tools_memory::reset_stats();
+  }
+
+  void OnTestEnd(const ::testing::TestInfo& info) override
+  {
+    auto stats = tools_memory::get_stats();
+    std::cout << "[ MEMORY   ] " << info.test_suite_name() << "."
+              << info.name() << ": " << stats.allocations << " allocations, "
+              << stats.bytes << " bytes, peak heap " << stats.peak_bytes
+              << " bytes, peak RSS " << tools_memory::get_peak_rss()
+              << " bytes" << std::endl;
+  }
+};
+
 int
 main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
+  if (tools_memory::is_counting()) {
+    ::testing::UnitTest::GetInstance()->listeners().Append(new MemoryListener);
+  }
   return RUN_ALL_TESTS();
 }